@@ -0,0 +1,132 @@
+#include "Backend.hh"
+#include "Linker.hh"
+#include "Log.hh"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace grace;
+
+void grace::initializeTargets() {
+  InitializeAllTargetInfos();
+  InitializeAllTargets();
+  InitializeAllTargetMCs();
+  InitializeAllAsmParsers();
+  InitializeAllAsmPrinters();
+}
+
+std::unique_ptr<TargetMachine>
+grace::createTargetMachine(const std::string &Triple, const Options &Opts) {
+  std::string Error;
+  auto Target = TargetRegistry::lookupTarget(Triple, Error);
+
+  if (!Target) {
+    Log::message() << Error << "\n";
+    return nullptr;
+  }
+
+  TargetOptions Opt;
+  // Position independent code links into executables and also loads at any
+  // address the JIT picks.
+  auto RM = Optional<Reloc::Model>(Reloc::PIC_);
+  return std::unique_ptr<TargetMachine>(Target->createTargetMachine(
+      Triple, Opts.CPU, Opts.Features, Opt, RM, None,
+      getCodeGenOptLevel(Opts.Opt)));
+}
+
+bool grace::emitToBuffer(Module &M, TargetMachine &TM,
+                         TargetMachine::CodeGenFileType FileType,
+                         SmallVectorImpl<char> &Buffer) {
+  raw_svector_ostream OS(Buffer);
+  legacy::PassManager PM;
+
+  if (TM.addPassesToEmitFile(PM, OS, nullptr, FileType)) {
+    Log::message() << "TheTargetMachine can't emit a file of this type\n";
+    return false;
+  }
+
+  PM.run(M);
+  return true;
+}
+
+std::string grace::getDefaultOutput(StringRef Input, EmitKind Kind) {
+  const char *Ext = nullptr;
+  switch (Kind) {
+  case EmitKind::Exe:
+    return "a.out";
+  case EmitKind::Obj:
+    Ext = "o";
+    break;
+  case EmitKind::Asm:
+    Ext = "s";
+    break;
+  case EmitKind::LLVM:
+    Ext = "ll";
+    break;
+  case EmitKind::BC:
+    Ext = "bc";
+    break;
+  }
+
+  SmallString<128> Output(sys::path::filename(Input));
+  sys::path::replace_extension(Output, Ext);
+  return Output.str().str();
+}
+
+static bool writeFile(StringRef Path, StringRef Data) {
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::F_None);
+
+  if (EC) {
+    Log::message() << "Could not open file: " << EC.message() << "\n";
+    return false;
+  }
+
+  OS << Data;
+  return true;
+}
+
+int grace::emitOutput(Module &M, TargetMachine &TM, const Options &Opts,
+                      StringRef Input) {
+  std::string Output =
+      Opts.Output.empty() ? getDefaultOutput(Input, Opts.Emit) : Opts.Output;
+
+  if (Opts.Emit == EmitKind::LLVM || Opts.Emit == EmitKind::BC) {
+    std::error_code EC;
+    raw_fd_ostream OS(Output, EC,
+                      Opts.Emit == EmitKind::LLVM ? sys::fs::F_Text
+                                                  : sys::fs::F_None);
+    if (EC) {
+      Log::message() << "Could not open file: " << EC.message() << "\n";
+      return 1;
+    }
+
+    if (Opts.Emit == EmitKind::LLVM)
+      M.print(OS, nullptr);
+    else
+      WriteBitcodeToFile(M, OS);
+    return 0;
+  }
+
+  // Objects and assembly are produced in memory; only the final output ever
+  // touches the file system.
+  SmallVector<char, 0> Buffer;
+  auto FileType = Opts.Emit == EmitKind::Asm ? TargetMachine::CGFT_AssemblyFile
+                                             : TargetMachine::CGFT_ObjectFile;
+  if (!emitToBuffer(M, TM, FileType, Buffer))
+    return 1;
+
+  StringRef Data(Buffer.data(), Buffer.size());
+  if (Opts.Emit != EmitKind::Exe)
+    return writeFile(Output, Data) ? 0 : 1;
+
+  MemoryBufferRef Object(Data, Input);
+  return linkExecutable(Object, Output, Triple(M.getTargetTriple())) ? 0 : 1;
+}
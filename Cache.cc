@@ -0,0 +1,113 @@
+#include "Cache.hh"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace grace;
+
+// Bump when the layout of cache entries or keys changes.
+static const char *const CacheFormat = "grace-object-cache-2";
+
+// Identifies the compiler binary, so rebuilding grace invalidates the cache
+// even when no version number changed.
+static std::string getCompilerId() {
+  std::string Id = LLVM_VERSION_STRING;
+
+  auto Exe = sys::fs::getMainExecutable(
+      nullptr, reinterpret_cast<void *>(&getCompilerId));
+  sys::fs::file_status Status;
+  if (!sys::fs::status(Exe, Status))
+    Id += ";" + std::to_string(Status.getSize()) + ";" +
+          std::to_string(sys::toTimeT(Status.getLastModificationTime()));
+
+  return Id;
+}
+
+// Feed one field into Hasher, length prefixed so fields cannot run together.
+static void addField(SHA1 &Hasher, StringRef Field) {
+  Hasher.update(std::to_string(Field.size()));
+  Hasher.update(":");
+  Hasher.update(Field);
+}
+
+std::string CompileCache::getDefaultDir() {
+  SmallString<128> Dir;
+  if (auto XDG = sys::Process::GetEnv("XDG_CACHE_HOME"))
+    Dir = *XDG;
+  else if (sys::path::home_directory(Dir))
+    sys::path::append(Dir, ".cache");
+  else
+    return "";
+
+  sys::path::append(Dir, "grace");
+  return Dir.str().str();
+}
+
+std::string CompileCache::hashSource(StringRef Source) {
+  SHA1 Hasher;
+  Hasher.update(Source);
+  return toHex(Hasher.final(), /*LowerCase=*/true);
+}
+
+std::string CompileCache::getKey(StringRef SourceHash, StringRef Imports,
+                                 const std::string &Triple,
+                                 const Options &Opts) {
+  static const std::string CompilerId = getCompilerId();
+
+  SHA1 Hasher;
+  addField(Hasher, CacheFormat);
+  addField(Hasher, CompilerId);
+  addField(Hasher, Triple);
+  addField(Hasher, Opts.getCodegenFingerprint());
+  addField(Hasher, Imports);
+  addField(Hasher, SourceHash);
+
+  return toHex(Hasher.final(), /*LowerCase=*/true);
+}
+
+std::string CompileCache::getPath(StringRef Key) const {
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, Key + ".o");
+  return Path.str().str();
+}
+
+std::unique_ptr<MemoryBuffer> CompileCache::lookup(StringRef Key) const {
+  auto Buffer = MemoryBuffer::getFile(getPath(Key), -1,
+                                      /*RequiresNullTerminator=*/false);
+  if (!Buffer)
+    return nullptr;
+  return std::move(*Buffer);
+}
+
+void CompileCache::store(StringRef Key, StringRef Object) const {
+  if (sys::fs::create_directories(Dir))
+    return;
+
+  int FD;
+  SmallString<128> TempPath(Dir);
+  sys::path::append(TempPath, "tmp-%%%%%%%%.o");
+  if (sys::fs::createUniqueFile(TempPath, FD, TempPath))
+    return;
+
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Object;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+
+  // Another compiler may have stored the same entry meanwhile; its contents
+  // are identical, so losing the race is harmless.
+  if (sys::fs::rename(TempPath, getPath(Key)))
+    sys::fs::remove(TempPath);
+}
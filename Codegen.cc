@@ -1,21 +1,296 @@
+#include "AST.hh"
 #include "Context.hh"
 #include "iostream"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Verifier.h"
+#include <algorithm>
+#include <cstdint>
 
 using namespace llvm;
 using namespace grace;
 
+// __builtin_expect's weights in clang.
+static const uint32_t LikelyWeight = 2000;
+static const uint32_t UnlikelyWeight = 1;
+
 /// CreateEntryBlockAlloca - Create an alloca instruction in the entry block of
 /// the function.  This is used for mutable variables etc.
 static AllocaInst *CreateEntryBlockAlloca(Function *TheFunction,
                                           LLVMContext &TheContext,
-                                          const std::string &Name,
+                                          const Twine &Name,
                                           llvm::Type *T) {
   IRBuilder<> TmpB(&TheFunction->getEntryBlock(),
                    TheFunction->getEntryBlock().begin());
   return TmpB.CreateAlloca(T, nullptr, Name);
 }
 
+// The value of Var at the insertion point: loaded from its stack slot or
+// global, or for locals under --direct-ssa looked up by the SSA builder.
+static Value *readVariable(Context &C, Variable *Var) {
+  auto &Builder = C.getBuilder();
+  if (C.Opts.DirectSSA && !Var->Global)
+    return C.SSA.read(Var, Var->Ty->emit(C), Builder.GetInsertBlock());
+  return Builder.CreateLoad(Var->Storage, Var->Id.str());
+}
+
+static void writeVariable(Context &C, Variable *Var, Value *V) {
+  auto &Builder = C.getBuilder();
+  if (C.Opts.DirectSSA && !Var->Global)
+    C.SSA.write(Var, Builder.GetInsertBlock(), V);
+  else
+    Builder.CreateStore(V, Var->Storage);
+}
+
+// Tell the SSA builder that every predecessor of BB has been generated.
+static void sealBlock(Context &C, BasicBlock *BB) {
+  if (C.Opts.DirectSSA)
+    C.SSA.seal(BB);
+}
+
+// The branch weights of a condition passed to likely() or unlikely(), or
+// null without a hint.
+static MDNode *createHintWeights(Context &C, BranchHint Hint) {
+  MDBuilder MDB(C.getContext());
+  switch (Hint) {
+  case BranchHint::None:
+    return nullptr;
+  case BranchHint::Likely:
+    return MDB.createBranchWeights(LikelyWeight, UnlikelyWeight);
+  case BranchHint::Unlikely:
+    return MDB.createBranchWeights(UnlikelyWeight, LikelyWeight);
+  }
+  llvm_unreachable("unknown branch hint");
+}
+
+// Fall through to BB, unless the block being generated already ended in a
+// return, skip or stop.
+static void branchTo(IRBuilder<> &Builder, BasicBlock *BB) {
+  if (!Builder.GetInsertBlock()->getTerminator())
+    Builder.CreateBr(BB);
+}
+
+namespace {
+
+// The values an int expression may take, as far as its shape tells. Lets
+// --overflow=trap leave out checks that can never fire, and tells where the
+// other modes may mark an operation nsw.
+struct IntRange {
+  int64_t Lo = INT32_MIN;
+  int64_t Hi = INT32_MAX;
+
+  IntRange() = default;
+  IntRange(int64_t Lo, int64_t Hi) : Lo(Lo), Hi(Hi) {}
+
+  bool contains(int64_t V) const { return Lo <= V && V <= Hi; }
+  bool fitsInt() const { return Lo >= INT32_MIN && Hi <= INT32_MAX; }
+};
+
+} // namespace
+
+// The exact result range of Op on operands in L and R, computed in 64 bits.
+// Only meaningful for +, - and *, where it overflows int exactly when the
+// operation may.
+static IntRange combine(BinOp Op, IntRange L, IntRange R) {
+  switch (Op) {
+  case BinOp::PLUS:
+    return {L.Lo + R.Lo, L.Hi + R.Hi};
+  case BinOp::MINUS:
+    return {L.Lo - R.Hi, L.Hi - R.Lo};
+  case BinOp::TIMES: {
+    int64_t P[] = {L.Lo * R.Lo, L.Lo * R.Hi, L.Hi * R.Lo, L.Hi * R.Hi};
+    return {*std::min_element(P, P + 4), *std::max_element(P, P + 4)};
+  }
+  default:
+    return {};
+  }
+}
+
+// Only the counters of enclosing for loops have known ranges.
+static IntRange getRange(Context &C, const Variable *Var) {
+  auto It = C.CounterRanges.find(Var);
+  if (It == C.CounterRanges.end())
+    return {};
+  return {It->second.first, It->second.second};
+}
+
+static IntRange getRange(Context &C, ExprNode *E) {
+  if (auto L = dynamic_cast<LiteralIntNode *>(E))
+    return {L->IVal, L->IVal};
+
+  if (auto V = dynamic_cast<VariableExprNode *>(E))
+    return getRange(C, V->getVariable());
+
+  if (auto N = dynamic_cast<ExprNegativeNode *>(E)) {
+    IntRange R = getRange(C, N->getRHS());
+    IntRange Result(-R.Hi, -R.Lo);
+    return Result.fitsInt() ? Result : IntRange();
+  }
+
+  auto O = dynamic_cast<ExprOperationNode *>(E);
+  if (!O)
+    return {};
+
+  IntRange L = getRange(C, O->getLHS()), R = getRange(C, O->getRHS());
+  switch (O->getOp()) {
+  case BinOp::PLUS:
+  case BinOp::MINUS:
+  case BinOp::TIMES: {
+    IntRange Result = combine(O->getOp(), L, R);
+    return Result.fitsInt() ? Result : IntRange();
+  }
+  case BinOp::MOD: {
+    // The remainder is smaller than the divisor and has the dividend's sign.
+    if (R.Lo != R.Hi || R.Lo == 0)
+      return {};
+    int64_t Max = std::abs(R.Lo) - 1;
+    return {L.Lo < 0 ? -Max : 0, L.Hi > 0 ? Max : 0};
+  }
+  case BinOp::BITAND:
+    if (R.Lo >= 0)
+      return {0, R.Hi};
+    if (L.Lo >= 0)
+      return {0, L.Hi};
+    return {};
+  case BinOp::LSHR:
+    if (R.Lo == R.Hi && R.Lo > 0 && R.Lo < 32)
+      return {0, int64_t(UINT32_MAX >> R.Lo)};
+    return {};
+  case BinOp::ASHR:
+    if (R.Lo == R.Hi && R.Lo >= 0 && R.Lo < 32)
+      return {L.Lo >> R.Lo, L.Hi >> R.Lo};
+    return {};
+  default:
+    return {};
+  }
+}
+
+// Branch to the function's trap block when Cond holds, and carry on in a new
+// block named ContName.
+static void emitTrapIf(Context &C, Value *Cond, const Twine &ContName) {
+  auto &Builder = C.getBuilder();
+  auto TheFunction = Builder.GetInsertBlock()->getParent();
+
+  if (!C.TrapBB || C.TrapBB->getParent() != TheFunction) {
+    auto SavedBB = Builder.GetInsertBlock();
+    C.TrapBB = BasicBlock::Create(C.getContext(), "trap", TheFunction);
+    Builder.SetInsertPoint(C.TrapBB);
+    Builder.CreateCall(
+        Intrinsic::getDeclaration(&C.getModule(), Intrinsic::trap));
+    Builder.CreateUnreachable();
+    Builder.SetInsertPoint(SavedBB);
+  }
+
+  auto ContBB = BasicBlock::Create(C.getContext(), ContName, TheFunction);
+  MDBuilder MDB(C.getContext());
+  Builder.CreateCondBr(Cond, C.TrapBB, ContBB,
+                       MDB.createBranchWeights(UnlikelyWeight, LikelyWeight));
+  sealBlock(C, ContBB);
+  Builder.SetInsertPoint(ContBB);
+}
+
+// Signed division and remainder. INT_MIN / -1 is the one quotient that
+// overflows, and LLVM leaves it undefined; unless the operands' ranges rule
+// it out, --overflow=wrap computes it as -LHS (and the remainder as 0)
+// without dividing, and --overflow=trap checks for it. The same holds for
+// int64, whose operands have no known ranges.
+static Value *emitDivRem(Context &C, BinOp Op, Value *LHSV, Value *RHSV,
+                         IntRange L, IntRange R) {
+  auto &Builder = C.getBuilder();
+  bool IsDiv = Op == BinOp::DIV;
+  OverflowKind Mode = C.Opts.Overflow;
+  auto Ty = LHSV->getType();
+  bool Known = Ty->isIntegerTy(INT_SIZE);
+
+  if (Mode == OverflowKind::Undefined ||
+      (Known && (!L.contains(INT32_MIN) || !R.contains(-1))))
+    return IsDiv ? Builder.CreateSDiv(LHSV, RHSV)
+                 : Builder.CreateSRem(LHSV, RHSV);
+
+  auto MinusOne = Builder.CreateICmpEQ(RHSV, ConstantInt::getSigned(Ty, -1));
+
+  if (Mode == OverflowKind::Trap) {
+    auto IsMin = Builder.CreateICmpEQ(
+        LHSV, ConstantInt::get(Ty, APInt::getSignedMinValue(
+                                       Ty->getIntegerBitWidth())));
+    emitTrapIf(C, Builder.CreateAnd(IsMin, MinusOne), "no_overflow");
+    return IsDiv ? Builder.CreateSDiv(LHSV, RHSV)
+                 : Builder.CreateSRem(LHSV, RHSV);
+  }
+
+  // x % 1 is 0 like x % -1, so the remainder only needs the safe divisor.
+  auto SafeRHSV = Builder.CreateSelect(MinusOne, ConstantInt::get(Ty, 1), RHSV);
+  if (!IsDiv)
+    return Builder.CreateSRem(LHSV, SafeRHSV);
+
+  auto Quotient = Builder.CreateSDiv(LHSV, SafeRHSV);
+  return Builder.CreateSelect(MinusOne, Builder.CreateNeg(LHSV), Quotient);
+}
+
+// Emit int or int64 arithmetic following --overflow. An int operation whose
+// operand ranges prove it cannot overflow is marked nsw in every mode and
+// never checked; ranges are not tracked for int64.
+static Value *emitArith(Context &C, BinOp Op, Value *LHSV, Value *RHSV,
+                        IntRange L, IntRange R) {
+  if (Op == BinOp::DIV || Op == BinOp::MOD)
+    return emitDivRem(C, Op, LHSV, RHSV, L, R);
+
+  auto &Builder = C.getBuilder();
+  OverflowKind Mode = C.Opts.Overflow;
+  bool CannotOverflow = LHSV->getType()->isIntegerTy(INT_SIZE) &&
+                        combine(Op, L, R).fitsInt();
+
+  if (Mode == OverflowKind::Trap && !CannotOverflow) {
+    Intrinsic::ID ID = Op == BinOp::PLUS    ? Intrinsic::sadd_with_overflow
+                       : Op == BinOp::MINUS ? Intrinsic::ssub_with_overflow
+                                            : Intrinsic::smul_with_overflow;
+    auto F = Intrinsic::getDeclaration(&C.getModule(), ID, LHSV->getType());
+    auto Pair = Builder.CreateCall(F, {LHSV, RHSV});
+    emitTrapIf(C, Builder.CreateExtractValue(Pair, 1), "no_overflow");
+    return Builder.CreateExtractValue(Pair, 0);
+  }
+
+  bool NSW = Mode == OverflowKind::Undefined || CannotOverflow;
+  switch (Op) {
+  case BinOp::PLUS:
+    return Builder.CreateAdd(LHSV, RHSV, "", false, NSW);
+  case BinOp::MINUS:
+    return Builder.CreateSub(LHSV, RHSV, "", false, NSW);
+  case BinOp::TIMES:
+    return Builder.CreateMul(LHSV, RHSV, "", false, NSW);
+  default:
+    llvm_unreachable("not an arithmetic operator");
+  }
+}
+
+// Emit float or double arithmetic. The builder adds the fast-math flags of
+// --fast-math.
+static Value *emitFloatArith(Context &C, BinOp Op, Value *LHSV, Value *RHSV) {
+  auto &Builder = C.getBuilder();
+  switch (Op) {
+  case BinOp::PLUS:
+    return Builder.CreateFAdd(LHSV, RHSV);
+  case BinOp::MINUS:
+    return Builder.CreateFSub(LHSV, RHSV);
+  case BinOp::TIMES:
+    return Builder.CreateFMul(LHSV, RHSV);
+  case BinOp::DIV:
+    return Builder.CreateFDiv(LHSV, RHSV);
+  default:
+    llvm_unreachable("not a floating point operator");
+  }
+}
+
+// Emit the arithmetic Op on two values of the numeric type Ty.
+static Value *emitNumericArith(Context &C, grace::Type *Ty, BinOp Op,
+                               Value *LHSV, Value *RHSV, IntRange L,
+                               IntRange R) {
+  if (Ty->isFloatingPointTy())
+    return emitFloatArith(C, Op, LHSV, RHSV);
+  return emitArith(C, Op, LHSV, RHSV, L, R);
+}
+
 Value *BlockNode::codegen(Context &C) {
   for (auto &Stmt : Stmts)
     Stmt->codegen(C);
@@ -27,6 +302,14 @@ Value *LiteralIntNode::codegen(Context &C) {
   return ConstantInt::get(C.getContext(), APInt(INT_SIZE, IVal));
 }
 
+Value *LiteralInt64Node::codegen(Context &C) {
+  return ConstantInt::get(C.getContext(), APInt(INT64_SIZE, IVal, true));
+}
+
+Value *LiteralFloatNode::codegen(Context &C) {
+  return ConstantFP::get(Ty->emit(C), FVal);
+}
+
 Value *LiteralBoolNode::codegen(Context &C) {
   LLVMContext &TheContext = C.getContext();
   return ConstantInt::get(TheContext, APInt(BOOL_SIZE, BVal ? 1 : 0));
@@ -44,111 +327,130 @@ Value *IfThenElseNode::codegen(Context &C) {
   auto LastBB =
       Else ? BasicBlock::Create(TheContext, "else", TheFunction) : MergeBB;
 
-  auto CondV = Condition->codegen(C);
-  auto CondVTy = Type::from(CondV->getType());
-
-  if (!CondVTy->isBoolTy()) {
-    Log::error(Condition->loc.begin) << "'" << CondVTy->str() << "' is not convertible to '"
-                     << Type::boolTy()->str() << "'\n";
-    return nullptr;
-  }
-
-  Builder.CreateCondBr(CondV, ThenBB, LastBB);
+  Condition->codegenCond(C, ThenBB, LastBB);
+  sealBlock(C, ThenBB);
 
   Builder.SetInsertPoint(ThenBB);
   C.ST.enterScope();
   Then->codegen(C);
   C.ST.leaveScope();
 
-  Builder.CreateBr(MergeBB);
+  branchTo(Builder, MergeBB);
 
   if (Else) {
+    sealBlock(C, LastBB);
     Builder.SetInsertPoint(LastBB);
     C.ST.enterScope();
     Else->codegen(C);
     C.ST.leaveScope();
 
-    Builder.CreateBr(MergeBB);
+    branchTo(Builder, MergeBB);
   }
 
+  sealBlock(C, MergeBB);
   Builder.SetInsertPoint(MergeBB);
 
   return nullptr;
 }
 
 Value *FuncDeclNode::codegen(Context &C) {
-  auto Sym = dynamic_cast<FuncSymbol *>(C.ST.get(Name));
-
-  // Check if function is already defined.
-  if (Sym) {
-    Log::error(loc.begin) << "function " << Name << " already defined\n";
-    return nullptr;
-  }
-
   // Create vector with llvm types for args.
   std::vector<llvm::Type *> ArgsType;
   ArgsType.reserve(Args->size());
   for (auto Arg : *Args)
-    ArgsType.push_back(Arg->Ty->emit(C));
+    ArgsType.push_back(Arg->Ty->emitParam(C));
 
   // Create function signature.
   FunctionType *FT = FunctionType::get(ReturnTy->emit(C), ArgsType, false);
-  auto F = Function::Create(FT, GlobalValue::LinkageTypes::ExternalLinkage,
-                            Name, &C.getModule());
+
+  // Nothing outside the unit can call a function that is not exported, so
+  // the optimizer may drop it, specialize its arguments and give it the fast
+  // calling convention.
+  auto Linkage = isExported() ? GlobalValue::ExternalLinkage
+                              : GlobalValue::InternalLinkage;
+  auto F = Function::Create(FT, Linkage, Name.str(), &C.getModule());
+  if (!isExported())
+    F->setCallingConv(CallingConv::Fast);
+  C.setTargetAttributes(F);
+  F->addFnAttr(Attribute::NoUnwind);
 
   // set args
   unsigned Idx = 0;
   for (auto &Arg : F->args())
-    Arg.setName((*Args)[Idx++]->Id);
+    Arg.setName((*Args)[Idx++]->Id.str());
 
   BasicBlock *BB = BasicBlock::Create(C.getContext(), "entry", F);
   C.getBuilder().SetInsertPoint(BB);
+  C.SSA.clear();
+  sealBlock(C, BB);
 
   std::vector<Type *> ArgsTy;
   for (auto Arg : *Args)
     ArgsTy.push_back(Arg->Ty);
 
-  C.ST.set(Name, new FuncSymbol(F, ReturnTy, ArgsTy));
-  C.ST.enterScope();
+  C.ST.set<FuncSymbol>(Name, F, ReturnTy, ArgsTy);
+  C.setArgumentAttributes(F, ArgsTy);
 
-  // insert args into scope
+  // Give every parameter a stack slot, so it can be assigned like a local.
+  // Arrays cannot be assigned and are reached through the pointer itself.
   Idx = 0;
   for (auto &Arg : F->args()) {
+    if ((*Args)[Idx]->Ty->isArrayTy()) {
+      (*Args)[Idx++]->Storage = &Arg;
+      continue;
+    }
+
+    if (C.Opts.DirectSSA) {
+      C.SSA.write((*Args)[Idx++], BB, &Arg);
+      continue;
+    }
+
     AllocaInst *Alloca =
         CreateEntryBlockAlloca(F, C.getContext(), Arg.getName(), Arg.getType());
 
     C.getBuilder().CreateStore(&Arg, Alloca);
-
-    C.ST.set(Arg.getName(), new VariableSymbol(Alloca, (*Args)[Idx++]->Ty));
+    (*Args)[Idx++]->Storage = Alloca;
   }
 
   // generate function body
-  C.ReturnFound = false;
   Body->codegen(C);
 
-  C.ST.leaveScope();
-
-  if (!C.ReturnFound) {
-    Log::warning(Body->loc.end) << "expected a return statement inside function body, "
-                          "but none was found.\n";
-    return nullptr;
-  }
-
   return nullptr;
 }
 
 Value *VarDeclNode::codegen(Context &C) {
-  if (C.ST.get(Id)) {
-    Log::error(loc.begin) << "variable " << Id << " already declared.\n";
+  if (Var.Global) {
+    // Sema only lets literals initialize globals, so the initializer folds
+    // to a constant.
+    auto Ty = Var.Ty->emit(C);
+    auto Init = Assign ? cast<Constant>(Assign->getValue()->codegen(C))
+                       : Constant::getNullValue(Ty);
+    auto GV = new GlobalVariable(C.getModule(), Ty, false,
+                                 GlobalValue::InternalLinkage, Init,
+                                 Var.Id.str());
+    Var.Storage = GV;
+    if (Var.Ty->isArrayTy()) {
+      Constant *Zero = C.getBuilder().getInt32(0);
+      Constant *Indices[] = {Zero, Zero};
+      Var.Storage = ConstantExpr::getInBoundsGetElementPtr(Ty, GV, Indices);
+    }
     return nullptr;
   }
 
   Function *TheFunction = C.getBuilder().GetInsertBlock()->getParent();
 
-  AllocaInst *Alloca =
-      CreateEntryBlockAlloca(TheFunction, C.getContext(), Id, Ty->emit(C));
-
-  C.ST.set(Id, new VariableSymbol(Alloca, Ty));
+  if (Var.Ty->isArrayTy()) {
+    // Arrays are always reached through their first element, like the
+    // arrays passed as parameters.
+    auto Alloca = CreateEntryBlockAlloca(TheFunction, C.getContext(),
+                                         Var.Id.str(), Var.Ty->emit(C));
+    IRBuilder<> TmpB(Alloca->getParent(), std::next(Alloca->getIterator()));
+    Var.Storage = TmpB.CreateConstInBoundsGEP2_32(Var.Ty->emit(C), Alloca, 0,
+                                                   0, Var.Id.str());
+  } else if (!C.Opts.DirectSSA) {
+    Var.Storage = CreateEntryBlockAlloca(TheFunction, C.getContext(),
+                                         Var.Id.str(), Var.Ty->emit(C));
+  }
 
   if (Assign)
     Assign->codegen(C);
@@ -157,8 +459,6 @@ Value *VarDeclNode::codegen(Context &C) {
 }
 
 Value *ReturnNode::codegen(Context &C) {
-  C.ReturnFound = true;
-
   IRBuilder<> &Builder = C.getBuilder();
 
   if (expr)
@@ -168,70 +468,180 @@ Value *ReturnNode::codegen(Context &C) {
 }
 
 Value *SkipNode::codegen(Context &C) {
-  auto Sym = dynamic_cast<BlockSymbol *>(C.ST.get("skip"));
-
-  if (!Sym)
-    Log::error(loc.begin) << "skip command can appear only inside loops.\n";
-  else
-    C.getBuilder().CreateBr(Sym->BB);
-
+  auto Sym = cast<BlockSymbol>(C.ST.get("skip"));
+  C.getBuilder().CreateBr(Sym->BB);
   return nullptr;
 }
 
 Value *StopNode::codegen(Context &C) {
-  auto Sym = dynamic_cast<BlockSymbol *>(C.ST.get("stop"));
+  auto Sym = cast<BlockSymbol>(C.ST.get("stop"));
+  C.getBuilder().CreateBr(Sym->BB);
+  return nullptr;
+}
 
-  if (!Sym)
-    Log::error(loc.begin) << "stop command can appear only inside loops.\n";
-  else
-    C.getBuilder().CreateBr(Sym->BB);
+// The llvm.loop metadata of L: a distinct node that names the loop by
+// referring to itself, followed by what its hints ask for.
+static MDNode *createLoopID(Context &C, const LoopNode &L) {
+  auto &TheContext = C.getContext();
+  auto Property = [&](StringRef Name, Metadata *Value) -> Metadata * {
+    return MDNode::get(TheContext, {MDString::get(TheContext, Name), Value});
+  };
+  auto Int32 = [&](unsigned V) {
+    return ConstantAsMetadata::get(
+        ConstantInt::get(llvm::Type::getInt32Ty(TheContext), V));
+  };
+  auto Bool = [&](bool V) {
+    return ConstantAsMetadata::get(
+        ConstantInt::get(llvm::Type::getInt1Ty(TheContext), V));
+  };
+
+  SmallVector<Metadata *, 4> Ops{nullptr};
+
+  if (L.Unroll == HintState::Disable)
+    Ops.push_back(MDNode::get(
+        TheContext, MDString::get(TheContext, "llvm.loop.unroll.disable")));
+  else if (L.Unroll == HintState::Enable && L.UnrollCount)
+    Ops.push_back(Property("llvm.loop.unroll.count", Int32(L.UnrollCount)));
+  else if (L.Unroll == HintState::Enable)
+    Ops.push_back(MDNode::get(
+        TheContext, MDString::get(TheContext, "llvm.loop.unroll.enable")));
+
+  if (L.Vectorize == HintState::Disable) {
+    Ops.push_back(Property("llvm.loop.vectorize.width", Int32(1)));
+  } else if (L.Vectorize == HintState::Enable) {
+    Ops.push_back(Property("llvm.loop.vectorize.enable", Bool(true)));
+    if (L.VectorizeWidth)
+      Ops.push_back(
+          Property("llvm.loop.vectorize.width", Int32(L.VectorizeWidth)));
+  }
 
-  return nullptr;
+  auto LoopID = MDNode::getDistinct(TheContext, Ops);
+  LoopID->replaceOperandWith(0, LoopID);
+  return LoopID;
+}
+
+// Branch back to BodyBB while Cond holds, from the single latch of the loop.
+// The condition is computed as a value, so even with && and || there is
+// exactly one back edge to carry the loop's metadata.
+static void emitLatch(Context &C, const LoopNode &L, ExprNode *Cond,
+                      BasicBlock *BodyBB, BasicBlock *ExitBB) {
+  auto Call = dynamic_cast<CallExprNode *>(Cond);
+  auto Weights = Call ? createHintWeights(C, Call->Hint) : nullptr;
+
+  auto Br = C.getBuilder().CreateCondBr(Cond->codegen(C), BodyBB, ExitBB,
+                                        Weights);
+  Br->setMetadata(LLVMContext::MD_loop, createLoopID(C, L));
 }
 
+// The values Counter takes in the body of for (Start; End; Step), when the
+// loop counts up while Counter < N or Counter <= N, in steps that cannot
+// overflow. Sema only sets Counter when Start plainly assigns it its first
+// value and the body never assigns it.
+static bool getCounterRange(Context &C, Variable *Counter, AssignNode *Start,
+                            ExprNode *End, AssignNode *Step,
+                            IntRange &Result) {
+  if (!Counter || Step->getVariable() != Counter || Step->getIndex())
+    return false;
+
+  auto IsCounter = [&](ExprNode *E) {
+    auto V = dynamic_cast<VariableExprNode *>(E);
+    return V && V->getVariable() == Counter;
+  };
+
+  auto Cond = dynamic_cast<ExprOperationNode *>(End);
+  if (!Cond || (Cond->getOp() != BinOp::LT && Cond->getOp() != BinOp::LTEQ) ||
+      !IsCounter(Cond->getLHS()))
+    return false;
+
+  IntRange Increment;
+  if (auto Compound = dynamic_cast<CompoundAssignNode *>(Step)) {
+    if (Compound->Op != BinOp::PLUS)
+      return false;
+    Increment = getRange(C, Step->getValue());
+  } else {
+    auto Sum = dynamic_cast<ExprOperationNode *>(Step->getValue());
+    if (!Sum || Sum->getOp() != BinOp::PLUS)
+      return false;
+    if (IsCounter(Sum->getLHS()))
+      Increment = getRange(C, Sum->getRHS());
+    else if (IsCounter(Sum->getRHS()))
+      Increment = getRange(C, Sum->getLHS());
+    else
+      return false;
+  }
+
+  IntRange Bound = getRange(C, Cond->getRHS());
+  IntRange Body(getRange(C, Start->getValue()).Lo,
+                Cond->getOp() == BinOp::LT ? Bound.Hi - 1 : Bound.Hi);
+  if (Increment.Lo < 0 || Body.Lo > Body.Hi ||
+      !combine(BinOp::PLUS, Body, Increment).fitsInt())
+    return false;
+
+  Result = Body;
+  return true;
+}
+
+// Loops are generated rotated: the condition is tested once in front of the
+// loop and then at the bottom of every iteration, so the body is entered
+// from a preheader, repeats through a single latch and leaves through a
+// dedicated exit block.
+//
+//   guard:     if (!cond) goto after_loop
+//   preheader: goto loop
+//   loop:      body             (skip goes to latch, stop to exit)
+//   latch:     step; if (cond) goto loop
+//   exit:      goto after_loop
 Value *ForNode::codegen(Context &C) {
   auto &Builder = C.getBuilder();
   auto &TheContext = C.getContext();
   auto TheFunction = Builder.GetInsertBlock()->getParent();
 
-  auto BeforeLoopBB =
-      BasicBlock::Create(TheContext, "before_loop", TheFunction);
-  auto LoopBB = BasicBlock::Create(TheContext, "loop", TheFunction);
-  auto StepBB = BasicBlock::Create(TheContext, "step", TheFunction);
+  auto PreheaderBB =
+      BasicBlock::Create(TheContext, "loop.preheader", TheFunction);
+  auto BodyBB = BasicBlock::Create(TheContext, "loop", TheFunction);
+  auto LatchBB = BasicBlock::Create(TheContext, "loop.latch", TheFunction);
+  auto ExitBB = BasicBlock::Create(TheContext, "loop.exit", TheFunction);
   auto AfterLoopBB = BasicBlock::Create(TheContext, "after_loop", TheFunction);
 
-  C.ST.set("skip", new BlockSymbol(StepBB));
-  C.ST.set("stop", new BlockSymbol(AfterLoopBB));
-
   Start->codegen(C);
 
-  Builder.CreateBr(BeforeLoopBB);
-
-  Builder.SetInsertPoint(BeforeLoopBB);
+  End->codegenCond(C, PreheaderBB, AfterLoopBB);
+  sealBlock(C, PreheaderBB);
 
-  auto CondV = End->codegen(C);
-  if (!CondV)
-    return nullptr;
-
-  auto CondTy = Type::from(CondV->getType());
-  if (!CondTy->isBoolTy()) {
-    Log::error(End->loc.begin) << "'" << CondTy->str() << "' is not convertible to '"
-                     << Type::boolTy()->str() << "'\n";
-    return nullptr;
-  }
+  Builder.SetInsertPoint(PreheaderBB);
+  Builder.CreateBr(BodyBB);
 
-  Builder.CreateCondBr(CondV, LoopBB, AfterLoopBB);
+  Builder.SetInsertPoint(BodyBB);
 
-  Builder.SetInsertPoint(LoopBB);
+  // The counter keeps its range until the step, which it lets bounds and
+  // overflow checks leave out.
+  IntRange CounterRange;
+  bool HasRange = getCounterRange(C, Counter, Start, End, Step, CounterRange);
+  if (HasRange)
+    C.CounterRanges[Counter] = {CounterRange.Lo, CounterRange.Hi};
 
+  // skip and stop are bound in the body's scope, so they refer to the
+  // innermost loop and disappear after it.
   C.ST.enterScope();
+  C.ST.set<BlockSymbol>("skip", LatchBB);
+  C.ST.set<BlockSymbol>("stop", ExitBB);
   Body->codegen(C);
   C.ST.leaveScope();
 
-  Builder.SetInsertPoint(StepBB);
+  branchTo(Builder, LatchBB);
+  sealBlock(C, LatchBB);
+
+  Builder.SetInsertPoint(LatchBB);
   Step->codegen(C);
+  if (HasRange)
+    C.CounterRanges.erase(Counter);
+  emitLatch(C, *this, End, BodyBB, ExitBB);
+  sealBlock(C, BodyBB);
+  sealBlock(C, ExitBB);
 
-  Builder.CreateBr(BeforeLoopBB);
+  Builder.SetInsertPoint(ExitBB);
+  Builder.CreateBr(AfterLoopBB);
+  sealBlock(C, AfterLoopBB);
 
   Builder.SetInsertPoint(AfterLoopBB);
 
@@ -241,79 +651,162 @@ Value *ForNode::codegen(Context &C) {
 Value *WhileNode::codegen(Context &C) {
   auto &Builder = C.getBuilder();
   auto &TheContext = C.getContext();
-
   auto TheFunction = Builder.GetInsertBlock()->getParent();
 
-  auto BeforeLoopBB =
-      BasicBlock::Create(TheContext, "before_loop", TheFunction);
-  auto LoopBB = BasicBlock::Create(TheContext, "loop", TheFunction);
+  auto PreheaderBB =
+      BasicBlock::Create(TheContext, "loop.preheader", TheFunction);
+  auto BodyBB = BasicBlock::Create(TheContext, "loop", TheFunction);
+  auto LatchBB = BasicBlock::Create(TheContext, "loop.latch", TheFunction);
+  auto ExitBB = BasicBlock::Create(TheContext, "loop.exit", TheFunction);
   auto AfterLoopBB = BasicBlock::Create(TheContext, "after_loop", TheFunction);
 
-  C.ST.set("skip", new BlockSymbol(LoopBB));
-  C.ST.set("stop", new BlockSymbol(AfterLoopBB));
-
-  Builder.CreateBr(BeforeLoopBB);
-  Builder.SetInsertPoint(BeforeLoopBB);
+  Condition->codegenCond(C, PreheaderBB, AfterLoopBB);
+  sealBlock(C, PreheaderBB);
 
-  auto CondV = Condition->codegen(C);
-  auto CondTy = Type::from(CondV->getType());
-  if (!CondTy->isBoolTy()) {
-    Log::error(Condition->loc.begin) << "'" << CondTy->str() << "' is not convertible to '"
-                     << Type::boolTy()->str() << "'\n";
-    return nullptr;
-  }
+  Builder.SetInsertPoint(PreheaderBB);
+  Builder.CreateBr(BodyBB);
 
-  Builder.CreateCondBr(CondV, LoopBB, AfterLoopBB);
-
-  Builder.SetInsertPoint(LoopBB);
+  Builder.SetInsertPoint(BodyBB);
 
+  // skip re-evaluates the condition.
   C.ST.enterScope();
+  C.ST.set<BlockSymbol>("skip", LatchBB);
+  C.ST.set<BlockSymbol>("stop", ExitBB);
   Block->codegen(C);
   C.ST.leaveScope();
 
-  Builder.CreateBr(BeforeLoopBB);
+  branchTo(Builder, LatchBB);
+  sealBlock(C, LatchBB);
+
+  Builder.SetInsertPoint(LatchBB);
+  emitLatch(C, *this, Condition, BodyBB, ExitBB);
+  sealBlock(C, BodyBB);
+  sealBlock(C, ExitBB);
+
+  Builder.SetInsertPoint(ExitBB);
+  Builder.CreateBr(AfterLoopBB);
+  sealBlock(C, AfterLoopBB);
 
   Builder.SetInsertPoint(AfterLoopBB);
 
   return nullptr;
 }
 
-Value *VariableExprNode::codegen(Context &C) {
-  auto Sym = dynamic_cast<VariableSymbol *>(C.ST.get(Id));
-  if (!Sym) {
-    Log::error(loc.begin) << "variable '" << Id << "' not declared.\n";
-    return nullptr;
+// The address of Var[Index]. Under --bounds-check an index that may be out
+// of range traps first, unless the array's size is unknown.
+static Value *emitElementPtr(Context &C, Variable *Var, ExprNode *Index) {
+  auto &Builder = C.getBuilder();
+  Value *IndexV = Index->codegen(C);
+  unsigned Size = Var->Ty->getArraySize();
+
+  IntRange R = getRange(C, Index);
+  if (C.Opts.BoundsCheck && Size && !(R.Lo >= 0 && R.Hi < Size)) {
+    // Negative indices are huge unsigned, so one compare covers both ends.
+    auto OutOfBounds = Builder.CreateICmpUGE(
+        IndexV, ConstantInt::get(IndexV->getType(), Size));
+    emitTrapIf(C, OutOfBounds, "in_bounds");
   }
 
-  return C.getBuilder().CreateLoad(Sym->Alloca, Id);
+  return Builder.CreateInBoundsGEP(Var->Ty->getElementType()->emit(C),
+                                   Var->Storage, IndexV);
+}
+
+Value *VariableExprNode::codegen(Context &C) {
+  // An array is only ever passed along, by reference.
+  if (Var->Ty->isArrayTy())
+    return Var->Storage;
+  return readVariable(C, Var);
+}
+
+Value *IndexExprNode::codegen(Context &C) {
+  Value *Ptr = emitElementPtr(C, Var, Index);
+  return C.getBuilder().CreateLoad(Ptr, Id.str());
+}
+
+Value *AssignNode::codegenElementPtr(Context &C) {
+  return emitElementPtr(C, Var, Index);
 }
 
+// A literal is a long string pointing straight at its characters in the
+// module's constants, however short it is, so nothing is copied at run time.
 Value *LiteralStringNode::codegen(Context &C) {
-  return C.getBuilder().CreateGlobalStringPtr(Str);
+  auto Chars = C.getGlobalString(Str);
+  auto Size = ConstantInt::get(C.getBuilder().getInt64Ty(),
+                               Str.size() | (UINT64_C(1) << 63));
+  return ConstantStruct::get(C.getStringTy(), {Chars, Size});
 }
 
-llvm::Value *AssignNode::codegen(Context &C) {
-  auto Sym = dynamic_cast<VariableSymbol *>(C.ST.get(Id));
-  if (!Sym) {
-    Log::error(loc.begin) << "variable '" << Id << "' not declared.\n";
-    return nullptr;
-  }
+// Whether the string Str keeps its characters out of line: the top bit of
+// its second word, which holds the length byte of a short string.
+static Value *emitIsLongString(Context &C, Value *Str) {
+  auto &Builder = C.getBuilder();
+  Value *Size = Builder.CreateExtractValue(Str, 1);
+  return Builder.CreateICmpSLT(Size, Builder.getInt64(0), "is.long");
+}
 
+// The number of characters in Str, computed inline.
+static Value *emitStringLength(Context &C, Value *Str) {
+  auto &Builder = C.getBuilder();
+  Value *Size = Builder.CreateExtractValue(Str, 1);
+  Value *LongSize = Builder.CreateAnd(Size, INT64_MAX);
+  Value *ShortSize = Builder.CreateLShr(Size, 56);
+  Value *Length =
+      Builder.CreateSelect(emitIsLongString(C, Str), LongSize, ShortSize);
+  return Builder.CreateTrunc(Length, Builder.getInt32Ty(), "length");
+}
 
-  Value *Store = Assign->codegen(C);
-  if (!Store)
-    return nullptr;
+// A pointer to the null-terminated characters of Str, for the C functions.
+// A short string is copied to the stack of the calling function.
+static Value *emitCString(Context &C, Value *Str) {
+  auto &Builder = C.getBuilder();
+  auto Slot = CreateEntryBlockAlloca(Builder.GetInsertBlock()->getParent(),
+                                     C.getContext(), "short.str",
+                                     C.getStringTy());
+  Builder.CreateStore(Str, Slot);
+  Value *Short = Builder.CreateBitCast(Slot, Builder.getInt8PtrTy());
+  Value *Long = Builder.CreateExtractValue(Str, 0);
+  return Builder.CreateSelect(emitIsLongString(C, Str), Long, Short);
+}
 
-  auto AssignTy = Type::from(Store->getType());
-  auto DeclaredTy = Sym->Ty;
+// Concatenation and comparisons of two strings, done by the runtime.
+static Value *emitStringOperation(Context &C, BinOp Op, Value *LHSV,
+                                  Value *RHSV) {
+  auto &Builder = C.getBuilder();
+  if (Op == BinOp::PLUS)
+    return Builder.CreateCall(C.RT.StrConcat, {LHSV, RHSV});
+
+  Value *Zero = Builder.getInt32(0);
+  if (Op == BinOp::EQ || Op == BinOp::DIFF) {
+    Value *Equal = Builder.CreateCall(C.RT.StrEqual, {LHSV, RHSV});
+    return Op == BinOp::EQ ? Builder.CreateICmpNE(Equal, Zero)
+                           : Builder.CreateICmpEQ(Equal, Zero);
+  }
 
-  if (*AssignTy != *DeclaredTy) {
-    Log::error(Assign->loc.begin) << "cannot assign value of type '" << AssignTy->str()
-                     << "', expected '" << DeclaredTy->str() << "'\n";
-    return nullptr;
+  Value *Order = Builder.CreateCall(C.RT.StrCompare, {LHSV, RHSV});
+  switch (Op) {
+  case BinOp::LT:
+    return Builder.CreateICmpSLT(Order, Zero);
+  case BinOp::LTEQ:
+    return Builder.CreateICmpSLE(Order, Zero);
+  case BinOp::GT:
+    return Builder.CreateICmpSGT(Order, Zero);
+  case BinOp::GTEQ:
+    return Builder.CreateICmpSGE(Order, Zero);
+  default:
+    llvm_unreachable("not an operator on strings");
+  }
+}
+
+llvm::Value *AssignNode::codegen(Context &C) {
+  if (Index) {
+    Value *Ptr = codegenElementPtr(C);
+    Value *Store = Assign->codegen(C);
+    C.getBuilder().CreateStore(Store, Ptr);
+    return Store;
   }
 
-  C.getBuilder().CreateStore(Store, Sym->Alloca);
+  Value *Store = Assign->codegen(C);
+  writeVariable(C, Var, Store);
 
   return Store;
 }
@@ -327,37 +820,176 @@ Value *VarDeclNodeListStmt::codegen(Context &C) {
 
 Value *ExprNegativeNode::codegen(Context &C) {
   Value *RHSV = RHS->codegen(C);
-  return C.getBuilder().CreateNeg(RHSV);
+  if (Ty->isFloatingPointTy())
+    return C.getBuilder().CreateFNeg(RHSV);
+  return emitArith(C, BinOp::MINUS, ConstantInt::get(RHSV->getType(), 0), RHSV,
+                   IntRange(0, 0), getRange(C, RHS));
+}
+
+Value *ConvertExprNode::codegen(Context &C) {
+  auto &Builder = C.getBuilder();
+  Value *RHSV = RHS->codegen(C);
+  grace::Type *FromTy = RHS->Ty;
+  llvm::Type *DestTy = Ty->emit(C);
+
+  if (FromTy == Ty)
+    return RHSV;
+  if (FromTy->isIntegerTy() && Ty->isIntegerTy())
+    return Builder.CreateSExtOrTrunc(RHSV, DestTy);
+  if (FromTy->isIntegerTy())
+    return Builder.CreateSIToFP(RHSV, DestTy);
+  if (Ty->isIntegerTy())
+    return Builder.CreateFPToSI(RHSV, DestTy);
+  return Ty->isDoubleTy() ? Builder.CreateFPExt(RHSV, DestTy)
+                          : Builder.CreateFPTrunc(RHSV, DestTy);
 }
 
 Value *ExprNotNode::codegen(Context &C) {
   Value *RHSV = RHS->codegen(C);
-  auto Ty = Type::from(RHSV->getType());
+  return C.getBuilder().CreateNot(RHSV);
+}
+
+void ExprNode::codegenCond(Context &C, BasicBlock *True, BasicBlock *False) {
+  C.getBuilder().CreateCondBr(codegen(C), True, False);
+}
+
+void ExprNotNode::codegenCond(Context &C, BasicBlock *True, BasicBlock *False) {
+  RHS->codegenCond(C, False, True);
+}
+
+// Arithmetic and comparisons of two floats or doubles. Comparisons are
+// false when either side is NaN, except for !=, which is true.
+static Value *emitFloatOperation(Context &C, BinOp Op, Value *LHSV,
+                                 Value *RHSV) {
+  auto &Builder = C.getBuilder();
+  switch (Op) {
+  case BinOp::LT:
+    return Builder.CreateFCmpOLT(LHSV, RHSV);
+  case BinOp::LTEQ:
+    return Builder.CreateFCmpOLE(LHSV, RHSV);
+  case BinOp::GT:
+    return Builder.CreateFCmpOGT(LHSV, RHSV);
+  case BinOp::GTEQ:
+    return Builder.CreateFCmpOGE(LHSV, RHSV);
+  case BinOp::EQ:
+    return Builder.CreateFCmpOEQ(LHSV, RHSV);
+  case BinOp::DIFF:
+    return Builder.CreateFCmpUNE(LHSV, RHSV);
+  default:
+    return emitFloatArith(C, Op, LHSV, RHSV);
+  }
+}
+
+// Emit a * b + c, a * b - c and c - a * b, written as one expression, as a
+// single llvm.fmuladd, which becomes a fused multiply-add on targets that
+// have one, as C compilers contract them by default. Return null for other
+// expressions. Under --fast-math the backend fuses the separate operations
+// itself, and the vectorizer only reduces those.
+static Value *emitMulAdd(Context &C, ExprNode *LHS, BinOp Op, ExprNode *RHS) {
+  auto AsMul = [](ExprNode *E) {
+    auto O = dynamic_cast<ExprOperationNode *>(E);
+    return O && O->getOp() == BinOp::TIMES ? O : nullptr;
+  };
 
-  if (!Ty->isBoolTy()) {
-    Log::error(RHS->loc.begin) << "'" << Ty->str() << "' is not convertible to '"
-                     << Type::boolTy()->str() << "'\n";
+  auto &Builder = C.getBuilder();
+  Value *A, *B, *Addend;
+  if (auto Mul = AsMul(LHS)) {
+    A = Mul->getLHS()->codegen(C);
+    B = Mul->getRHS()->codegen(C);
+    Addend = RHS->codegen(C);
+    if (Op == BinOp::MINUS)
+      Addend = Builder.CreateFNeg(Addend);
+  } else if (auto Mul = AsMul(RHS)) {
+    Addend = LHS->codegen(C);
+    A = Mul->getLHS()->codegen(C);
+    B = Mul->getRHS()->codegen(C);
+    if (Op == BinOp::MINUS)
+      A = Builder.CreateFNeg(A);
+  } else {
     return nullptr;
   }
 
-  return C.getBuilder().CreateNot(RHSV);
+  auto F = Intrinsic::getDeclaration(&C.getModule(), Intrinsic::fmuladd,
+                                     A->getType());
+  return Builder.CreateCall(F, {A, B, Addend});
+}
+
+void ExprOperationNode::codegenCond(Context &C, BasicBlock *True,
+                                    BasicBlock *False) {
+  if (Op != BinOp::AND && Op != BinOp::OR) {
+    ExprNode::codegenCond(C, True, False);
+    return;
+  }
+
+  auto &Builder = C.getBuilder();
+  auto RHSBB = BasicBlock::Create(C.getContext(),
+                                  Op == BinOp::AND ? "and.rhs" : "or.rhs",
+                                  Builder.GetInsertBlock()->getParent());
+
+  if (Op == BinOp::AND)
+    LHS->codegenCond(C, RHSBB, False);
+  else
+    LHS->codegenCond(C, True, RHSBB);
+  sealBlock(C, RHSBB);
+
+  Builder.SetInsertPoint(RHSBB);
+  RHS->codegenCond(C, True, False);
 }
 
 Value *ExprOperationNode::codegen(Context &C) {
+  if (Op == BinOp::AND || Op == BinOp::OR) {
+    // RHS only runs when LHS does not decide the result, which the phi then
+    // takes from whichever block branched to the end.
+    auto &Builder = C.getBuilder();
+    auto TheFunction = Builder.GetInsertBlock()->getParent();
+    auto RHSBB = BasicBlock::Create(C.getContext(),
+                                    Op == BinOp::AND ? "and.rhs" : "or.rhs",
+                                    TheFunction);
+    auto EndBB = BasicBlock::Create(C.getContext(),
+                                    Op == BinOp::AND ? "and.end" : "or.end",
+                                    TheFunction);
+
+    if (Op == BinOp::AND)
+      LHS->codegenCond(C, RHSBB, EndBB);
+    else
+      LHS->codegenCond(C, EndBB, RHSBB);
+    sealBlock(C, RHSBB);
+
+    Builder.SetInsertPoint(RHSBB);
+    Value *RHSV = RHS->codegen(C);
+    BasicBlock *RHSEndBB = Builder.GetInsertBlock();
+    Builder.CreateBr(EndBB);
+    sealBlock(C, EndBB);
+
+    Builder.SetInsertPoint(EndBB);
+    auto Phi = Builder.CreatePHI(Builder.getInt1Ty(), 2);
+    for (auto Pred : predecessors(EndBB))
+      if (Pred != RHSEndBB)
+        Phi->addIncoming(Builder.getInt1(Op == BinOp::OR), Pred);
+    Phi->addIncoming(RHSV, RHSEndBB);
+    return Phi;
+  }
+
+  if (Ty->isFloatingPointTy() && !C.Opts.FastMath &&
+      (Op == BinOp::PLUS || Op == BinOp::MINUS))
+    if (Value *Fused = emitMulAdd(C, LHS, Op, RHS))
+      return Fused;
+
   Value *LHSV = LHS->codegen(C);
   Value *RHSV = RHS->codegen(C);
 
+  if (LHS->Ty->isStringTy())
+    return emitStringOperation(C, Op, LHSV, RHSV);
+  if (LHS->Ty->isFloatingPointTy())
+    return emitFloatOperation(C, Op, LHSV, RHSV);
+
   switch (Op) {
   case BinOp::PLUS:
-    return C.getBuilder().CreateAdd(LHSV, RHSV);
   case BinOp::MINUS:
-    return C.getBuilder().CreateSub(LHSV, RHSV);
   case BinOp::TIMES:
-    return C.getBuilder().CreateMul(LHSV, RHSV);
   case BinOp::DIV:
-    return C.getBuilder().CreateUDiv(LHSV, RHSV);
   case BinOp::MOD:
-    return C.getBuilder().CreateURem(LHSV, RHSV);
+    return emitArith(C, Op, LHSV, RHSV, getRange(C, LHS), getRange(C, RHS));
   case BinOp::LT:
     return C.getBuilder().CreateICmpSLT(LHSV, RHSV);
   case BinOp::LTEQ:
@@ -371,53 +1003,61 @@ Value *ExprOperationNode::codegen(Context &C) {
   case BinOp::DIFF:
     return C.getBuilder().CreateICmpNE(LHSV, RHSV);
   case BinOp::AND:
-    return C.getBuilder().CreateAnd(LHSV, RHSV);
   case BinOp::OR:
-    return C.getBuilder().CreateOr(LHSV, RHSV);
+    llvm_unreachable("&& and || are lowered to branches above");
+  case BinOp::SHL:
+    // Only Simplify makes shifts left, out of multiplications, which are
+    // never reduced under --overflow=trap.
+    return C.getBuilder().CreateShl(
+        LHSV, RHSV, "", false, C.Opts.Overflow == OverflowKind::Undefined);
+  case BinOp::LSHR:
+    return C.getBuilder().CreateLShr(LHSV, RHSV);
+  case BinOp::ASHR:
+    return C.getBuilder().CreateAShr(LHSV, RHSV);
+  case BinOp::BITAND:
+    return C.getBuilder().CreateAnd(LHSV, RHSV);
   }
+  llvm_unreachable("unknown binary operator");
 }
 
-Value *CallExprNode::codegen(Context &C) {
-  auto Sym = dynamic_cast<FuncSymbol *>(C.ST.get(Callee));
-
-  if (!Sym) {
-    Log::error(loc.begin) << "function '" << Callee << "' not found.\n";
-    return nullptr;
-  }
-
-  if (Sym->Function->arg_size() != Args->size()) {
-    Log::error(loc.begin) << "incorrect number of arguments passed to function "
-                     << Callee << "\n";
-    return nullptr;
-  }
-
-  std::vector<Value *> ArgsV;
-  for (auto Arg : *Args) {
-    ArgsV.push_back(Arg->codegen(C));
-    if (!ArgsV.back())
-      return nullptr;
+void CallExprNode::codegenCond(Context &C, BasicBlock *True,
+                               BasicBlock *False) {
+  if (Hint == BranchHint::None) {
+    ExprNode::codegenCond(C, True, False);
+    return;
   }
 
-  bool ErrorFound = false;
-  for (unsigned i = 0; i < Args->size(); ++i) {
+  Value *V = (*Args)[0]->codegen(C);
+  C.getBuilder().CreateCondBr(V, True, False, createHintWeights(C, Hint));
+}
 
-    auto DeclaredTy = Sym->Args[i];
-    auto PassedTy = Type::from(ArgsV[i]->getType());
+Value *CallExprNode::codegen(Context &C) {
+  if (Hint != BranchHint::None)
+    return (*Args)[0]->codegen(C);
+  if (IsLength)
+    return emitStringLength(C, (*Args)[0]->codegen(C));
 
-    if (*DeclaredTy != *PassedTy) {
-      Log::error((*Args)[i]->loc.begin) << "wrong param type passed to function '" << Callee
-                       << "' at index '" << std::to_string(i) << "', expected '"
-                       << DeclaredTy->str() << "', but found '"
-                       << PassedTy->str() << "'\n";
+  auto Sym = cast<FuncSymbol>(C.ST.get(Callee));
 
-      ErrorFound = true;
-    }
+  // The C functions take their strings as plain char pointers.
+  bool IsVararg = Sym->Function->isVarArg();
+  std::vector<Value *> ArgsV;
+  for (auto Arg : *Args) {
+    Value *V = Arg->codegen(C);
+    if (IsVararg && Arg->Ty->isStringTy())
+      V = emitCString(C, V);
+    ArgsV.push_back(V);
   }
 
-  if (ErrorFound)
-    return nullptr;
+  // printf and scanf go through stdio, which must not overtake what write
+  // statements left in the runtime's buffer.
+  if (Sym->Function->getName() == "printf" ||
+      Sym->Function->getName() == "scanf")
+    C.getBuilder().CreateCall(C.RT.Flush);
 
-  return C.getBuilder().CreateCall(Sym->Function, ArgsV);
+  auto Call = C.getBuilder().CreateCall(Sym->Function, ArgsV);
+  Call->setCallingConv(Sym->Function->getCallingConv());
+  return Call;
 }
 
 Value *ProcDeclNode::codegen(Context &C) {
@@ -425,70 +1065,149 @@ Value *ProcDeclNode::codegen(Context &C) {
   return nullptr;
 }
 
+// Print through the runtime's output buffer, one call per value. Literals are
+// spelled out at compile time, and consecutive ones, the newline included,
+// are appended with a single call.
 Value *WriteNode::codegen(Context &C) {
+  auto &Builder = C.getBuilder();
 
-  auto Sym = dynamic_cast<FuncSymbol *>(C.ST.get("printf"));
-  assert(Sym && "forgot to insert printf function");
-
-  auto StrFormat = C.getBuilder().CreateGlobalStringPtr("%s");
-  auto IntFormat = C.getBuilder().CreateGlobalStringPtr("%d");
-  auto NewLineFormat = C.getBuilder().CreateGlobalStringPtr("\n");
+  std::string Text;
+  auto WriteText = [&] {
+    if (Text.empty())
+      return;
+    Builder.CreateCall(C.RT.WriteChars, {C.getGlobalString(Text),
+                                         Builder.getInt32(Text.size())});
+    Text.clear();
+  };
 
   for (auto Expr : *Exprs) {
-    auto Value = Expr->codegen(C);
-    auto Ty = Type::from(Value->getType());
-
-    if (Ty->isIntTy() || Ty->isBoolTy()) {
-      C.getBuilder().CreateCall(Sym->Function, {IntFormat, Value});
-    } else if (Ty->isStringTy()) {
-      C.getBuilder().CreateCall(Sym->Function, {StrFormat, Value});
+    if (auto Str = dynamic_cast<LiteralStringNode *>(Expr)) {
+      Text += Str->Str;
+      continue;
+    }
+    if (auto Int = dynamic_cast<LiteralIntNode *>(Expr)) {
+      Text += std::to_string(Int->IVal);
+      continue;
+    }
+    if (auto Bool = dynamic_cast<LiteralBoolNode *>(Expr)) {
+      Text += Bool->BVal ? "true" : "false";
+      continue;
+    }
+    if (auto Int = dynamic_cast<LiteralInt64Node *>(Expr)) {
+      Text += std::to_string(Int->IVal);
+      continue;
     }
+
+    WriteText();
+    Value *V = Expr->codegen(C);
+    if (Expr->Ty->isStringTy())
+      Builder.CreateCall(C.RT.WriteStr, V);
+    else if (Expr->Ty->isBoolTy())
+      Builder.CreateCall(C.RT.WriteBool,
+                         Builder.CreateZExt(V, Builder.getInt32Ty()));
+    else if (Expr->Ty->isInt64Ty())
+      Builder.CreateCall(C.RT.WriteInt64, V);
+    else if (Expr->Ty->isFloatTy())
+      Builder.CreateCall(C.RT.WriteFloat, V);
+    else if (Expr->Ty->isDoubleTy())
+      Builder.CreateCall(C.RT.WriteDouble, V);
+    else
+      Builder.CreateCall(C.RT.WriteInt, V);
   }
 
-  C.getBuilder().CreateCall(Sym->Function, {NewLineFormat});
+  Text += '\n';
+  WriteText();
 
   return nullptr;
 }
 
-Value *CompoundAssignNode::codegen(Context &C) {
-  auto Sym = dynamic_cast<VariableSymbol *>(C.ST.get(Id));
+// Read one value of type Ty from the runtime's input.
+static Value *emitRead(Context &C, grace::Type *Ty) {
+  auto &Builder = C.getBuilder();
+  if (Ty->isIntTy())
+    return Builder.CreateCall(C.RT.ReadInt);
+  if (Ty->isInt64Ty())
+    return Builder.CreateCall(C.RT.ReadInt64);
+  if (Ty->isFloatTy())
+    return Builder.CreateCall(C.RT.ReadFloat);
+  if (Ty->isDoubleTy())
+    return Builder.CreateCall(C.RT.ReadDouble);
+  if (Ty->isBoolTy())
+    return Builder.CreateTrunc(Builder.CreateCall(C.RT.ReadBool),
+                               Builder.getInt1Ty());
+  return Builder.CreateCall(C.RT.ReadStr);
+}
 
-  if (!Sym) {
-    Log::error(loc.begin) << "variable '" << Id << "' not declared.\n";
-    return nullptr;
+Value *ReadNode::codegen(Context &C) {
+  auto &Builder = C.getBuilder();
+
+  for (auto Target : *Targets) {
+    if (auto Element = dynamic_cast<IndexExprNode *>(Target)) {
+      Value *Ptr =
+          emitElementPtr(C, Element->getVariable(), Element->getIndex());
+      Builder.CreateStore(emitRead(C, Element->Ty), Ptr);
+      continue;
+    }
+
+    auto Var = static_cast<VariableExprNode *>(Target)->getVariable();
+    if (!Var->Ty->isArrayTy()) {
+      writeVariable(C, Var, emitRead(C, Var->Ty));
+      continue;
+    }
+
+    // A whole array, which Sema made sure has a size and so at least one
+    // element, element by element.
+    BasicBlock *EntryBB = Builder.GetInsertBlock();
+    Function *TheFunction = EntryBB->getParent();
+    BasicBlock *LoopBB =
+        BasicBlock::Create(C.getContext(), "read", TheFunction);
+    BasicBlock *DoneBB =
+        BasicBlock::Create(C.getContext(), "read_done", TheFunction);
+
+    Builder.CreateBr(LoopBB);
+    Builder.SetInsertPoint(LoopBB);
+    auto I = Builder.CreatePHI(Builder.getInt32Ty(), 2, "i");
+    I->addIncoming(Builder.getInt32(0), EntryBB);
+
+    Value *Ptr = Builder.CreateInBoundsGEP(Var->Ty->getElementType()->emit(C),
+                                           Var->Storage, I);
+    Builder.CreateStore(emitRead(C, Var->Ty->getElementType()), Ptr);
+
+    Value *Next = Builder.CreateNUWAdd(I, Builder.getInt32(1), "i.next");
+    I->addIncoming(Next, LoopBB);
+    Builder.CreateCondBr(
+        Builder.CreateICmpULT(Next,
+                              Builder.getInt32(Var->Ty->getArraySize())),
+        LoopBB, DoneBB);
+    sealBlock(C, LoopBB);
+
+    sealBlock(C, DoneBB);
+    Builder.SetInsertPoint(DoneBB);
   }
 
-  auto Alloca = Sym->Alloca;
-  Value *Store = Assign->codegen(C);
+  return nullptr;
+}
+
+Value *CompoundAssignNode::codegen(Context &C) {
+  if (Index) {
+    Value *Ptr = codegenElementPtr(C);
+    Value *Store = Assign->codegen(C);
 
-  auto AllocatedTy = Sym->Ty;
-  auto AssigningTy = Type::from(Store->getType());
+    Value *Current = C.getBuilder().CreateLoad(Ptr, Id.str());
+    Value *Result = emitNumericArith(C, Assign->Ty, Op, Current, Store,
+                                     IntRange(), getRange(C, Assign));
 
-  if (*AllocatedTy != *AssigningTy) {
-    Log::error(Assign->loc.begin) << "cannot assign value of type '" << AssigningTy->str()
-                     << "', expected '" << AllocatedTy->str() << "'\n";
+    C.getBuilder().CreateStore(Result, Ptr);
     return nullptr;
   }
 
-  Value *AllocaValue = C.getBuilder().CreateLoad(Alloca, Id);
-  Value *Result = nullptr;
+  Value *Store = Assign->codegen(C);
 
-  switch (Op) {
-  case BinOp::PLUS:
-    Result = C.getBuilder().CreateAdd(Store, AllocaValue);
-    break;
-  case BinOp::MINUS:
-    Result = C.getBuilder().CreateSub(Store, AllocaValue);
-    break;
-  case BinOp::TIMES:
-    Result = C.getBuilder().CreateMul(Store, AllocaValue);
-    break;
-  case BinOp::DIV:
-    Result = C.getBuilder().CreateUDiv(Store, AllocaValue);
-    break;
-  }
+  Value *Current = readVariable(C, Var);
+  Value *Result = emitNumericArith(C, Assign->Ty, Op, Current, Store,
+                                   getRange(C, Var), getRange(C, Assign));
 
-  C.getBuilder().CreateStore(Result, Alloca);
+  writeVariable(C, Var, Result);
 
   return nullptr;
 }
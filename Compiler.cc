@@ -0,0 +1,424 @@
+#include "Compiler.hh"
+#include "Backend.hh"
+#include "Cache.hh"
+#include "Context.hh"
+#include "Driver.hh"
+#include "JIT.hh"
+#include "Linker.hh"
+#include "Log.hh"
+#include "Sema.hh"
+#include "Simplify.hh"
+#include "Source.hh"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+using namespace llvm;
+using namespace grace;
+
+namespace {
+
+// Everything produced for one input file. Each Unit has its own Driver,
+// Context and LLVMContext, so units never share mutable state.
+struct Unit {
+  std::string File;
+  Driver Drv;
+
+  // The source until the Driver takes it, and its hash for the cache.
+  std::unique_ptr<SourceBuffer> Source;
+  std::string SourceHash;
+
+  bool Parsed = false;
+  bool Failed = false;
+
+  std::unique_ptr<Context> C;
+  std::unique_ptr<TargetMachine> TM;
+
+  // Whether to produce an object file for linking or for the JIT.
+  bool WantObject = false;
+
+  // The object file, freshly generated or taken from the cache.
+  SmallVector<char, 0> Object;
+  std::unique_ptr<MemoryBuffer> CachedObject;
+
+  // The optimized IR, for --dump-ir.
+  std::string IR;
+
+  explicit Unit(std::string File) : File(std::move(File)) {}
+
+  StringRef getObject() const {
+    if (CachedObject)
+      return CachedObject->getBuffer();
+    return StringRef(Object.data(), Object.size());
+  }
+};
+
+typedef std::vector<std::unique_ptr<Unit>> UnitList;
+
+// A function exported by a unit, visible to the others.
+struct Signature {
+  std::string Name;
+  grace::Type *ReturnTy;
+  std::vector<grace::Type *> Args;
+  const Unit *Owner;
+};
+
+} // namespace
+
+// Read the source of U, and hash it for the cache before the scanner, which
+// works on the buffer in place, gets to it.
+static bool load(Unit &U, const CompileCache *Cache) {
+  U.Source = SourceBuffer::fromFile(U.File);
+  if (!U.Source)
+    return false;
+
+  if (Cache)
+    U.SourceHash = CompileCache::hashSource(U.Source->getBuffer());
+  return true;
+}
+
+static void parse(Unit &U, const CompileCache *Cache, const Options &Opts) {
+  U.Parsed = true;
+  if (!U.Source && !load(U, Cache)) {
+    U.Failed = true;
+    return;
+  }
+
+  U.Drv.trace_parsing = Opts.TraceParsing;
+  U.Drv.trace_scanning = Opts.TraceScanning;
+  U.Drv.use_fast_lexer = Opts.Lexer == LexerKind::Fast;
+  U.Failed = U.Drv.parse(U.File, std::move(U.Source)) != 0;
+}
+
+static std::vector<Signature> collectSignatures(const UnitList &Units) {
+  std::vector<Signature> Signatures;
+
+  for (const auto &U : Units) {
+    for (auto Stmt : U->Drv.program->Stmts) {
+      auto Func = dynamic_cast<FuncDeclNode *>(Stmt);
+      if (!Func || !Func->isExported())
+        continue;
+
+      Signature Sig{Func->getName().str().str(), Func->getReturnTy(), {},
+                    U.get()};
+      for (auto Arg : Func->getArgs())
+        Sig.Args.push_back(Arg->Ty);
+      Signatures.push_back(std::move(Sig));
+    }
+  }
+
+  return Signatures;
+}
+
+// Resolve names and check types of U, with the functions of the other units
+// in scope. Codegen only runs on units that pass.
+static bool analyze(Unit &U, const std::vector<Signature> &Signatures) {
+  Sema S(U.Drv.strings);
+
+  for (const auto &Sig : Signatures)
+    if (Sig.Owner != &U)
+      S.declareFunction(Sig.Name, Sig.ReturnTy, Sig.Args);
+
+  return S.check(*U.Drv.program);
+}
+
+// Check, simplify, generate, optimize and emit one unit. Runs on a pool
+// thread.
+static void generate(Unit &U, const std::vector<Signature> &Signatures,
+                     const Options &Opts) {
+  if (!analyze(U, Signatures)) {
+    U.Failed = true;
+    return;
+  }
+
+  Simplifier(U.Drv.arena, Opts.Overflow).simplify(*U.Drv.program);
+
+  U.C = std::make_unique<Context>(Opts, U.Drv.strings);
+  Context &C = *U.C;
+
+  for (const auto &Sig : Signatures)
+    if (Sig.Owner != &U)
+      C.declareFunction(Sig.Name, Sig.ReturnTy, Sig.Args);
+
+  U.Drv.program->codegen(C);
+  U.Drv.release_ast();
+
+  std::string Errors;
+  raw_string_ostream ErrorsOS(Errors);
+  if (verifyModule(C.getModule(), &ErrorsOS)) {
+    Log::message() << U.File << ": " << ErrorsOS.str();
+    U.Failed = true;
+    return;
+  }
+
+  auto TargetTriple = sys::getDefaultTargetTriple();
+  C.getModule().setTargetTriple(TargetTriple);
+
+  // TargetMachines are not thread safe, so every unit gets its own.
+  U.TM = createTargetMachine(TargetTriple, Opts);
+  if (!U.TM) {
+    U.Failed = true;
+    return;
+  }
+
+  C.getModule().setDataLayout(U.TM->createDataLayout());
+
+  C.optimize(*U.TM, Opts.Opt);
+
+  if (Opts.DumpIR) {
+    raw_string_ostream IR(U.IR);
+    C.dumpIR(IR);
+  }
+
+  if (U.WantObject)
+    U.Failed = !emitToBuffer(C.getModule(), *U.TM,
+                             TargetMachine::CGFT_ObjectFile, U.Object);
+  else if (!Opts.Run)
+    U.Failed = emitOutput(C.getModule(), *U.TM, Opts, U.File) != 0;
+
+  // Otherwise the JIT takes the optimized module as it is.
+}
+
+// The declarations U sees from the other units, as part of its cache key.
+static std::string getImports(const Unit &U,
+                              const std::vector<Signature> &Signatures) {
+  std::string Imports;
+
+  for (const auto &Sig : Signatures) {
+    if (Sig.Owner == &U)
+      continue;
+
+    Imports += Sig.Name + "(";
+    for (auto Arg : Sig.Args)
+      Imports += Arg->str() + ",";
+    Imports += "):" + Sig.ReturnTy->str() + ";";
+  }
+
+  return Imports;
+}
+
+// Produce the output of one unit, reusing a cached object when the source,
+// its imports and the codegen settings are unchanged. Runs on a pool thread.
+static void build(Unit &U, const std::vector<Signature> &Signatures,
+                  const CompileCache *Cache, const Options &Opts) {
+  std::string Key;
+
+  if (Cache) {
+    if (!U.Parsed && !load(U, Cache)) {
+      U.Failed = true;
+      return;
+    }
+
+    Key = CompileCache::getKey(U.SourceHash, getImports(U, Signatures),
+                               sys::getDefaultTargetTriple(), Opts);
+    if ((U.CachedObject = Cache->lookup(Key)))
+      return;
+  }
+
+  if (!U.Parsed) {
+    parse(U, Cache, Opts);
+    if (U.Failed)
+      return;
+  }
+
+  generate(U, Signatures, Opts);
+
+  if (!U.Failed && !Key.empty())
+    Cache->store(Key, U.getObject());
+}
+
+// Run Work on every unit in parallel and report whether any unit failed.
+template <typename WorkTy>
+static bool forEachUnit(ThreadPool &Pool, UnitList &Units, WorkTy Work) {
+  for (auto &U : Units) {
+    Unit *Current = U.get();
+    Pool.async([Current, &Work] { Work(*Current); });
+  }
+  Pool.wait();
+
+  bool Failed = false;
+  for (const auto &U : Units)
+    Failed |= U->Failed;
+  return Failed;
+}
+
+static void printToken(std::ostream &OS, const yy::parser::symbol_type &Tok) {
+  typedef yy::parser::symbol_kind Kind;
+
+  OS << Tok.location << ' ' << yy::parser::symbol_name(Tok.kind());
+  switch (Tok.kind()) {
+  case Kind::S_IDENTIFIER:
+    OS << ' ' << Tok.value.as<Identifier>();
+    break;
+  case Kind::S_NUMBER:
+    OS << ' ' << Tok.value.as<int>();
+    break;
+  case Kind::S_INT64_NUMBER:
+    OS << ' ' << Tok.value.as<int64_t>();
+    break;
+  case Kind::S_FLOAT_NUMBER:
+  case Kind::S_DOUBLE_NUMBER: {
+    // Every digit needed to tell the lexers' values apart.
+    char Buf[32];
+    snprintf(Buf, sizeof(Buf), "%.17g", Tok.value.as<double>());
+    OS << ' ' << Buf;
+    break;
+  }
+  case Kind::S_BOOL_LITERAL:
+    OS << ' ' << std::boolalpha << Tok.value.as<bool>();
+    break;
+  case Kind::S_STRING_LITERAL:
+    OS << " \"" << Tok.value.as<StringRef>().str() << '"';
+    break;
+  case Kind::S_TYPE_INT:
+  case Kind::S_TYPE_INT64:
+  case Kind::S_TYPE_FLOAT:
+  case Kind::S_TYPE_DOUBLE:
+  case Kind::S_TYPE_STRING:
+  case Kind::S_TYPE_BOOL:
+    OS << ' ' << Tok.value.as<std::string>();
+    break;
+  default:
+    break;
+  }
+  OS << '\n';
+}
+
+// Only run the scanner selected by Opts over Files, printing every token for
+// --dump-tokens or the scanning throughput for --lex-only. Files are scanned
+// one after another on this thread, so the timings are not disturbed.
+static int lexFiles(const std::vector<std::string> &Files,
+                    const Options &Opts) {
+  bool Failed = false;
+
+  for (const auto &File : Files) {
+    auto Source = SourceBuffer::fromFile(File);
+    if (!Source) {
+      Failed = true;
+      continue;
+    }
+
+    Driver Drv;
+    Drv.trace_scanning = Opts.TraceScanning;
+    Drv.use_fast_lexer = Opts.Lexer == LexerKind::Fast;
+
+    size_t Tokens = 0;
+    size_t Bytes = Source->getBuffer().size();
+    auto Start = std::chrono::steady_clock::now();
+
+    Failed |= Drv.lex(File, std::move(Source),
+                      [&](const yy::parser::symbol_type &Tok) {
+                        ++Tokens;
+                        if (Opts.DumpTokens)
+                          printToken(std::cout, Tok);
+                      }) != 0;
+
+    std::chrono::duration<double> Elapsed =
+        std::chrono::steady_clock::now() - Start;
+
+    if (Opts.LexOnly)
+      std::cout << File << ": " << Tokens << " tokens, " << std::fixed
+                << std::setprecision(2) << Bytes / 1e6 << " MB in "
+                << Elapsed.count() * 1e3 << " ms, "
+                << Bytes / 1e6 / Elapsed.count() << " MB/s\n";
+  }
+
+  return Failed ? 1 : 0;
+}
+
+int grace::compile(const std::vector<std::string> &Files,
+                   const Options &Opts) {
+  if (Files.empty()) {
+    Log::message() << "no input files\n";
+    return 1;
+  }
+
+  if (Opts.DumpTokens || Opts.LexOnly)
+    return lexFiles(Files, Opts);
+
+  if (Files.size() > 1 && !Opts.Output.empty() && !Opts.Run &&
+      Opts.Emit != EmitKind::Exe) {
+    Log::message() << "cannot specify -o when generating multiple output "
+                      "files\n";
+    return 1;
+  }
+
+  initializeTargets();
+
+  // Only objects are cached, and a cache hit has no AST or IR to dump.
+  std::unique_ptr<CompileCache> Cache;
+  if (!Opts.CacheDir.empty() && (Opts.Run || Opts.Emit == EmitKind::Exe) &&
+      !Opts.DumpAST && !Opts.DumpIR)
+    Cache = std::make_unique<CompileCache>(Opts.CacheDir);
+
+  UnitList Units;
+  for (const auto &File : Files) {
+    Units.push_back(std::make_unique<Unit>(File));
+    Units.back()->WantObject =
+        Opts.Run ? Cache != nullptr : Opts.Emit == EmitKind::Exe;
+  }
+
+  ThreadPool Pool(Opts.Jobs ? Opts.Jobs : heavyweight_hardware_concurrency());
+
+  // Every unit must be parsed up front to learn the functions it exports to
+  // the others. A lone unit can wait, so a cache hit skips parsing entirely.
+  std::vector<Signature> Signatures;
+  if (Units.size() > 1 || !Cache) {
+    if (forEachUnit(Pool, Units, [&](Unit &U) {
+          parse(U, Cache.get(), Opts);
+        }))
+      return 1;
+
+    if (Opts.DumpAST)
+      for (const auto &U : Units)
+        U->Drv.program->dumpAST(std::cout, 0);
+
+    Signatures = collectSignatures(Units);
+  }
+
+  bool Failed = forEachUnit(Pool, Units, [&](Unit &U) {
+    build(U, Signatures, Cache.get(), Opts);
+  });
+
+  if (Opts.DumpIR)
+    for (const auto &U : Units)
+      errs() << U->IR;
+
+  if (Failed)
+    return 1;
+
+  if (Opts.Run) {
+    std::vector<OwnedModule> Modules;
+    std::vector<std::unique_ptr<MemoryBuffer>> Objects;
+    for (auto &U : Units) {
+      if (U->WantObject)
+        Objects.push_back(
+            MemoryBuffer::getMemBufferCopy(U->getObject(), U->File));
+      else
+        Modules.emplace_back(U->C->takeModule(), U->C->takeContext());
+    }
+    return runJIT(std::move(Modules), std::move(Objects), Opts);
+  }
+
+  if (Opts.Emit != EmitKind::Exe)
+    return 0;
+
+  std::vector<MemoryBufferRef> Objects;
+  for (const auto &U : Units)
+    Objects.emplace_back(U->getObject(), U->File);
+
+  std::string Output = Opts.Output.empty()
+                           ? getDefaultOutput(Files.front(), EmitKind::Exe)
+                           : Opts.Output;
+  return linkExecutable(Objects, Output, Triple(sys::getDefaultTargetTriple()))
+             ? 0
+             : 1;
+}
@@ -3,20 +3,206 @@
 //
 
 #include <Context.hh>
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Transforms/IPO/ArgumentPromotion.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/SCCP.h"
 
 using namespace grace;
 
+static PassBuilder::OptimizationLevel toPassBuilderLevel(OptLevel Level) {
+  switch (Level) {
+  case OptLevel::O0:
+    return PassBuilder::O0;
+  case OptLevel::O1:
+    return PassBuilder::O1;
+  case OptLevel::O2:
+    return PassBuilder::O2;
+  case OptLevel::O3:
+    return PassBuilder::O3;
+  case OptLevel::Os:
+    return PassBuilder::Os;
+  }
+}
+
+void Context::declareFunction(const std::string &Name, Type *ReturnTy,
+                              const std::vector<Type *> &Args) {
+  std::vector<llvm::Type *> ArgsType;
+  ArgsType.reserve(Args.size());
+  for (auto Arg : Args)
+    ArgsType.push_back(Arg->emitParam(*this));
+
+  auto FT = llvm::FunctionType::get(ReturnTy->emit(*this), ArgsType, false);
+  auto F = llvm::Function::Create(FT, llvm::GlobalValue::ExternalLinkage, Name,
+                                  &getModule());
+  F->addFnAttr(llvm::Attribute::NoUnwind);
+  setArgumentAttributes(F, Args);
+
+  ST.set<FuncSymbol>(Name, F, ReturnTy, Args);
+}
+
+void Context::setArgumentAttributes(llvm::Function *F,
+                                    const std::vector<Type *> &Args) {
+  for (unsigned i = 0; i < Args.size(); ++i) {
+    if (!Args[i]->isArrayTy())
+      continue;
+
+    // Nothing can keep a reference to an array, and Sema rejects calls
+    // passing one array twice.
+    F->addParamAttr(i, llvm::Attribute::NoAlias);
+    F->addParamAttr(i, llvm::Attribute::NoCapture);
+
+    // The size of a string, which holds a pointer, is only known to the
+    // target.
+    auto ElementTy = Args[i]->getElementType()->emit(*this);
+    if (Args[i]->getArraySize() &&
+        (ElementTy->isIntegerTy() || ElementTy->isFloatingPointTy()))
+      F->addDereferenceableParamAttr(
+          i, uint64_t(Args[i]->getArraySize()) *
+                 ((ElementTy->getPrimitiveSizeInBits() + 7) / 8));
+  }
+}
+
+void Context::setTargetAttributes(llvm::Function *F) const {
+  F->addFnAttr("target-cpu", Opts.CPU);
+  if (!Opts.Features.empty())
+    F->addFnAttr("target-features", Opts.Features);
+
+  // What the fast-math flags on each instruction allow, for the backend.
+  if (Opts.FastMath) {
+    F->addFnAttr("unsafe-fp-math", "true");
+    F->addFnAttr("no-infs-fp-math", "true");
+    F->addFnAttr("no-nans-fp-math", "true");
+    F->addFnAttr("no-signed-zeros-fp-math", "true");
+  }
+}
+
+llvm::Constant *Context::getGlobalString(llvm::StringRef Str) {
+  auto &Global = GlobalStrings[Str];
+  if (Global)
+    return Global;
+
+  // Created on the module itself, since global initializers are generated
+  // before the builder has a block, and so a module.
+  auto Init = llvm::ConstantDataArray::getString(getContext(), Str);
+  auto GV = new llvm::GlobalVariable(getModule(), Init->getType(), true,
+                                     llvm::GlobalValue::PrivateLinkage, Init,
+                                     ".str");
+  GV->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+
+  llvm::Constant *Zero = TheBuilder.getInt32(0);
+  llvm::Constant *Indices[] = {Zero, Zero};
+  Global = llvm::ConstantExpr::getInBoundsGetElementPtr(Init->getType(), GV,
+                                                        Indices);
+  return Global;
+}
+
+void Context::optimize(llvm::TargetMachine &TM, OptLevel Level) {
+  // Keep -O0 output exactly as codegen produced it.
+  if (Level == OptLevel::O0)
+    return;
+
+  PassBuilder PB(&TM);
+
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+
+  // Register the default alias analysis stack first, otherwise GVN and LICM
+  // only see the empty AAManager registered by registerFunctionAnalyses.
+  FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
+
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  // Only O3 promotes pointer arguments by default. Arrays are passed by
+  // pointer, and internal functions reading a few elements are better off
+  // receiving them by value at every level.
+  if (Level != OptLevel::O3)
+    PB.registerCGSCCOptimizerLateEPCallback(
+        [](CGSCCPassManager &CGPM, PassBuilder::OptimizationLevel) {
+          CGPM.addPass(ArgumentPromotionPass());
+        });
+
+  ModulePassManager MPM;
+
+  // Drop the internal functions nothing calls before the pipeline spends
+  // time on them, and propagate the constants passed to the rest.
+  MPM.addPass(GlobalDCEPass());
+  MPM.addPass(IPSCCPPass());
+
+  // The default per-module pipeline promotes allocas (SROA/mem2reg), infers
+  // function attributes such as readnone and norecurse, inlines, and runs
+  // instcombine, GVN, LICM and the loop and SLP vectorizers.
+  MPM.addPass(PB.buildPerModuleDefaultPipeline(toPassBuilderLevel(Level)));
+  MPM.run(*TheModule, MAM);
+}
+
 void Context::insertPrintfAndScanf() {
   auto Int8PtrTy = llvm::Type::getInt8PtrTy(getContext());
   auto Int32Ty = llvm::Type::getInt32Ty(getContext());
 
-  auto FnType = llvm::FunctionType::get(Int32Ty, Int8PtrTy);
+  auto FnType = llvm::FunctionType::get(Int32Ty, Int8PtrTy, true);
 
   auto Printf = llvm::Function::Create(
       FnType, llvm::GlobalValue::ExternalLinkage, "printf", &getModule());
   auto Scanf = llvm::Function::Create(
       FnType, llvm::GlobalValue::ExternalLinkage, "scanf", &getModule());
+  Printf->addFnAttr(llvm::Attribute::NoUnwind);
+  Scanf->addFnAttr(llvm::Attribute::NoUnwind);
+
+  ST.set<FuncSymbol>("printf", Printf, Type::intTy(),
+                     std::vector<Type *>{Type::strTy()});
+  ST.set<FuncSymbol>("scanf", Scanf, Type::intTy(),
+                     std::vector<Type *>{Type::strTy()});
+}
+
+void Context::insertRuntime() {
+  auto VoidTy = llvm::Type::getVoidTy(getContext());
+  auto Int8PtrTy = llvm::Type::getInt8PtrTy(getContext());
+  auto Int32Ty = llvm::Type::getInt32Ty(getContext());
+  auto Int64Ty = llvm::Type::getInt64Ty(getContext());
+  auto FloatTy = llvm::Type::getFloatTy(getContext());
+  auto DoubleTy = llvm::Type::getDoubleTy(getContext());
+
+  auto Declare = [&](llvm::StringRef Name,
+                     llvm::ArrayRef<llvm::Type *> Params,
+                     llvm::Type *ResultTy = nullptr) {
+    auto FT = llvm::FunctionType::get(ResultTy ? ResultTy : VoidTy, Params,
+                                      false);
+    auto F = llvm::Function::Create(FT, llvm::GlobalValue::ExternalLinkage,
+                                    Name, &getModule());
+    F->addFnAttr(llvm::Attribute::NoUnwind);
+    return F;
+  };
+
+  RT.WriteInt = Declare("grace_write_int", {Int32Ty});
+  RT.WriteInt64 = Declare("grace_write_int64", {Int64Ty});
+  RT.WriteFloat = Declare("grace_write_float", {FloatTy});
+  RT.WriteDouble = Declare("grace_write_double", {DoubleTy});
+  RT.WriteBool = Declare("grace_write_bool", {Int32Ty});
+  RT.WriteStr = Declare("grace_write_str", {StringTy});
+  RT.WriteChars = Declare("grace_write_chars", {Int8PtrTy, Int32Ty});
+  RT.Flush = Declare("grace_flush", {});
+  RT.ReadInt = Declare("grace_read_int", {}, Int32Ty);
+  RT.ReadInt64 = Declare("grace_read_int64", {}, Int64Ty);
+  RT.ReadFloat = Declare("grace_read_float", {}, FloatTy);
+  RT.ReadDouble = Declare("grace_read_double", {}, DoubleTy);
+  RT.ReadBool = Declare("grace_read_bool", {}, Int32Ty);
+  RT.ReadStr = Declare("grace_read_str", {}, StringTy);
+  RT.StrConcat = Declare("grace_str_concat", {StringTy, StringTy}, StringTy);
+  RT.StrCompare = Declare("grace_str_compare", {StringTy, StringTy}, Int32Ty);
+  RT.StrEqual = Declare("grace_str_equal", {StringTy, StringTy}, Int32Ty);
+
+  RT.WriteChars->addParamAttr(0, llvm::Attribute::NoCapture);
 
-  ST.set("printf", new FuncSymbol(Printf, Type::intTy(), {Type::strTy()}));
-  ST.set("scanf", new FuncSymbol(Scanf, Type::intTy(), {Type::strTy()}));
+  // Only the characters are read, so repeated comparisons can be combined
+  // and hoisted out of loops.
+  RT.StrCompare->addFnAttr(llvm::Attribute::ReadOnly);
+  RT.StrEqual->addFnAttr(llvm::Attribute::ReadOnly);
 }
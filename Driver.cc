@@ -1,11 +1,23 @@
 #include "Driver.hh"
+#include "Log.hh"
 
 Driver::Driver()
-    : trace_parsing(false), trace_scanning(false), dump_ast(false),
-      dump_ir(false) {}
+    : program(nullptr), trace_parsing(false), trace_scanning(false),
+      use_fast_lexer(false), scanner(nullptr) {}
+
+Driver::~Driver() = default;
 
 int Driver::parse(const std::string &f) {
-  file = f;
+  auto src = grace::SourceBuffer::fromFile(f);
+  if (!src)
+    return 1;
+  return parse(f, std::move(src));
+}
+
+int Driver::parse(const std::string &name,
+                  std::unique_ptr<grace::SourceBuffer> src) {
+  file = name;
+  source = std::move(src);
   location.initialize(&file);
   scan_begin();
   yy::parser parser(*this);
@@ -13,4 +25,67 @@ int Driver::parse(const std::string &f) {
   int res = parser.parse();
   scan_end();
   return res;
-}
\ No newline at end of file
+}
+
+int Driver::lex(
+    const std::string &name, std::unique_ptr<grace::SourceBuffer> src,
+    llvm::function_ref<void(const yy::parser::symbol_type &)> sink) {
+  file = name;
+  source = std::move(src);
+  location.initialize(&file);
+  scan_begin();
+
+  int res = 0;
+  try {
+    for (;;) {
+      auto token = yylex(*this);
+      bool done = token.kind() == yy::parser::symbol_kind::S_YYEOF;
+      sink(token);
+      if (done)
+        break;
+    }
+  } catch (const yy::parser::syntax_error &e) {
+    Log::error(e.location.begin) << e.what() << "\n";
+    res = 1;
+  }
+
+  scan_end();
+  return res;
+}
+
+llvm::StringRef Driver::intern_literal(llvm::StringRef text) {
+  text = text.drop_front().drop_back();
+  if (text.find('\\') == llvm::StringRef::npos)
+    return strings.get(text).str();
+
+  std::string value;
+  value.reserve(text.size());
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] != '\\' || i + 1 == text.size()) {
+      value += text[i];
+      continue;
+    }
+
+    switch (char c = text[++i]) {
+    case 'n':
+      value += '\n';
+      break;
+    case 't':
+      value += '\t';
+      break;
+    case 'r':
+      value += '\r';
+      break;
+    default:
+      // Any other escaped character, such as \" or \\, stands for itself.
+      value += c;
+    }
+  }
+
+  return strings.get(value).str();
+}
+
+void Driver::release_ast() {
+  program = nullptr;
+  arena.reset();
+}
@@ -1 +1,10 @@
 #include "AST.hh"
+#include "Type.hh"
+
+using namespace grace;
+
+void ConvertExprNode::dumpAST(std::ostream &os, unsigned level) const {
+  os << NestedLevel(level) << "(" << ToTy->str() << std::endl;
+  RHS->dumpAST(os, level + 1);
+  os << ")" << std::endl;
+}
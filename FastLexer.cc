@@ -0,0 +1,470 @@
+#include "FastLexer.hh"
+#include "Driver.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GRACE_LEXER_X86
+#endif
+
+using namespace grace;
+
+typedef yy::parser P;
+
+namespace {
+
+// The character classes the scanner skips over in bulk.
+enum class CharClass {
+  Blank,     // [ \t\n]
+  Ident,     // [a-zA-Z_0-9]
+  Digit,     // [0-9]
+  LineBody,  // anything but \n, for // comments
+  StringBody // anything but " and \, inside string literals
+};
+
+inline bool isDigit(char C) { return C >= '0' && C <= '9'; }
+
+inline bool isIdentStart(char C) {
+  return ((C | 0x20) >= 'a' && (C | 0x20) <= 'z') || C == '_';
+}
+
+inline bool inClass(char C, CharClass Class) {
+  switch (Class) {
+  case CharClass::Blank:
+    return C == ' ' || C == '\t' || C == '\n';
+  case CharClass::Ident:
+    return isIdentStart(C) || isDigit(C);
+  case CharClass::Digit:
+    return isDigit(C);
+  case CharClass::LineBody:
+    return C != '\n';
+  case CharClass::StringBody:
+    return C != '"' && C != '\\';
+  }
+  return false;
+}
+
+const char *skipScalar(const char *P, const char *End, CharClass Class) {
+  while (P != End && inClass(*P, Class))
+    ++P;
+  return P;
+}
+
+size_t countNewlinesScalar(const char *P, const char *End) {
+  return std::count(P, End, '\n');
+}
+
+#ifdef __SSE2__
+// A bit per byte of V, set if the byte is in Class. Bytes of 0x80 and above
+// are negative as signed chars, so they never fall in the ASCII ranges.
+inline unsigned classMask(__m128i V, CharClass Class) {
+  auto Eq = [&](char C) { return _mm_cmpeq_epi8(V, _mm_set1_epi8(C)); };
+  auto Range = [](__m128i X, char Lo, char Hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(X, _mm_set1_epi8(Lo - 1)),
+                         _mm_cmplt_epi8(X, _mm_set1_epi8(Hi + 1)));
+  };
+
+  __m128i M = _mm_setzero_si128();
+  switch (Class) {
+  case CharClass::Blank:
+    M = _mm_or_si128(_mm_or_si128(Eq(' '), Eq('\t')), Eq('\n'));
+    break;
+  case CharClass::Ident:
+    M = _mm_or_si128(
+        _mm_or_si128(Range(_mm_or_si128(V, _mm_set1_epi8(0x20)), 'a', 'z'),
+                     Range(V, '0', '9')),
+        Eq('_'));
+    break;
+  case CharClass::Digit:
+    M = Range(V, '0', '9');
+    break;
+  case CharClass::LineBody:
+    return ~_mm_movemask_epi8(Eq('\n')) & 0xFFFF;
+  case CharClass::StringBody:
+    return ~_mm_movemask_epi8(_mm_or_si128(Eq('"'), Eq('\\'))) & 0xFFFF;
+  }
+  return _mm_movemask_epi8(M);
+}
+
+const char *skipSSE2(const char *P, const char *End, CharClass Class) {
+  while (End - P >= 16) {
+    __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+    unsigned Outside = ~classMask(V, Class) & 0xFFFF;
+    if (Outside)
+      return P + __builtin_ctz(Outside);
+    P += 16;
+  }
+  return skipScalar(P, End, Class);
+}
+
+size_t countNewlinesSSE2(const char *P, const char *End) {
+  size_t N = 0;
+  const __m128i Newline = _mm_set1_epi8('\n');
+  for (; End - P >= 16; P += 16) {
+    __m128i V = _mm_loadu_si128(reinterpret_cast<const __m128i *>(P));
+    N += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(V, Newline)));
+  }
+  return N + countNewlinesScalar(P, End);
+}
+#endif // __SSE2__
+
+#ifdef GRACE_LEXER_X86
+#define GRACE_AVX2 __attribute__((target("avx2")))
+
+GRACE_AVX2 inline __m256i rangeAVX2(__m256i X, char Lo, char Hi) {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(X, _mm256_set1_epi8(Lo - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(Hi + 1), X));
+}
+
+GRACE_AVX2 inline __m256i eqAVX2(__m256i X, char C) {
+  return _mm256_cmpeq_epi8(X, _mm256_set1_epi8(C));
+}
+
+GRACE_AVX2 inline uint32_t classMaskAVX2(__m256i V, CharClass Class) {
+  __m256i M = _mm256_setzero_si256();
+  switch (Class) {
+  case CharClass::Blank:
+    M = _mm256_or_si256(_mm256_or_si256(eqAVX2(V, ' '), eqAVX2(V, '\t')),
+                        eqAVX2(V, '\n'));
+    break;
+  case CharClass::Ident:
+    M = _mm256_or_si256(
+        _mm256_or_si256(
+            rangeAVX2(_mm256_or_si256(V, _mm256_set1_epi8(0x20)), 'a', 'z'),
+            rangeAVX2(V, '0', '9')),
+        eqAVX2(V, '_'));
+    break;
+  case CharClass::Digit:
+    M = rangeAVX2(V, '0', '9');
+    break;
+  case CharClass::LineBody:
+    return ~uint32_t(_mm256_movemask_epi8(eqAVX2(V, '\n')));
+  case CharClass::StringBody:
+    return ~uint32_t(_mm256_movemask_epi8(
+        _mm256_or_si256(eqAVX2(V, '"'), eqAVX2(V, '\\'))));
+  }
+  return uint32_t(_mm256_movemask_epi8(M));
+}
+
+GRACE_AVX2 const char *skipAVX2(const char *P, const char *End,
+                                CharClass Class) {
+  while (End - P >= 32) {
+    __m256i V = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(P));
+    uint32_t Outside = ~classMaskAVX2(V, Class);
+    if (Outside)
+      return P + __builtin_ctz(Outside);
+    P += 32;
+  }
+  return skipScalar(P, End, Class);
+}
+
+GRACE_AVX2 size_t countNewlinesAVX2(const char *P, const char *End) {
+  size_t N = 0;
+  for (; End - P >= 32; P += 32) {
+    __m256i V = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(P));
+    N += __builtin_popcount(uint32_t(_mm256_movemask_epi8(eqAVX2(V, '\n'))));
+  }
+  return N + countNewlinesScalar(P, End);
+}
+#endif // GRACE_LEXER_X86
+
+// The bulk scanning routines for the instruction set of this machine.
+struct Kernels {
+  const char *(*Skip)(const char *P, const char *End, CharClass Class);
+  size_t (*CountNewlines)(const char *P, const char *End);
+};
+
+Kernels selectKernels() {
+#ifdef GRACE_LEXER_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return {skipAVX2, countNewlinesAVX2};
+#endif
+#ifdef __SSE2__
+  return {skipSSE2, countNewlinesSSE2};
+#else
+  return {skipScalar, countNewlinesScalar};
+#endif
+}
+
+const Kernels &getKernels() {
+  static const Kernels K = selectKernels();
+  return K;
+}
+
+} // namespace
+
+FastLexer::FastLexer(Driver &Drv, llvm::StringRef Source)
+    : Drv(Drv), Cur(Source.begin()), End(Source.end()),
+      Counted(Source.begin()), LineStart(Source.begin()) {
+  getKernels();
+}
+
+yy::position FastLexer::getPosition(const char *P) {
+  if (P > Counted) {
+    if (size_t N = getKernels().CountNewlines(Counted, P)) {
+      Line += N;
+      LineStart =
+          Counted + llvm::StringRef(Counted, P - Counted).rfind('\n') + 1;
+    }
+    Counted = P;
+  }
+
+  return yy::position(Drv.location.begin.filename, Line, P - LineStart + 1);
+}
+
+yy::location FastLexer::getLocation(const char *Begin, const char *End) {
+  yy::position B = getPosition(Begin);
+  return yy::location(B, getPosition(End));
+}
+
+yy::parser::symbol_type FastLexer::next() {
+  const Kernels &K = getKernels();
+
+  for (;;) {
+    Cur = K.Skip(Cur, End, CharClass::Blank);
+    if (Cur == End)
+      return P::make_END(getLocation(End, End));
+
+    if (Cur[0] != '/' || End - Cur < 2 || Cur[1] != '/')
+      break;
+    Cur = K.Skip(Cur + 2, End, CharClass::LineBody);
+  }
+
+  const char *Begin = Cur;
+  if (isIdentStart(*Begin))
+    return lexIdentifier(Begin);
+  if (isDigit(*Begin))
+    return lexNumber(Begin);
+  if (*Begin == '"')
+    return lexString(Begin);
+  return lexPunctuation(Begin);
+}
+
+yy::parser::symbol_type FastLexer::lexIdentifier(const char *Begin) {
+  Cur = getKernels().Skip(Begin + 1, End, CharClass::Ident);
+  llvm::StringRef Text(Begin, Cur - Begin);
+  auto Loc = getLocation(Begin, Cur);
+
+  // Every keyword is 2 to 6 characters long.
+  if (Text.size() <= 6) {
+    if (Text == "for")
+      return P::make_FOR(Loc);
+    if (Text == "if")
+      return P::make_IF(Loc);
+    if (Text == "else")
+      return P::make_ELSE(Loc);
+    if (Text == "def")
+      return P::make_DEF(Loc);
+    if (Text == "export")
+      return P::make_EXPORT(Loc);
+    if (Text == "var")
+      return P::make_VAR(Loc);
+    if (Text == "true")
+      return P::make_BOOL_LITERAL(true, Loc);
+    if (Text == "false")
+      return P::make_BOOL_LITERAL(false, Loc);
+    if (Text == "while")
+      return P::make_WHILE(Loc);
+    if (Text == "return")
+      return P::make_RETURN(Loc);
+    if (Text == "stop")
+      return P::make_STOP(Loc);
+    if (Text == "skip")
+      return P::make_SKIP(Loc);
+    if (Text == "write")
+      return P::make_WRITE(Loc);
+    if (Text == "read")
+      return P::make_READ(Loc);
+    if (Text == "int")
+      return P::make_TYPE_INT("type_int", Loc);
+    if (Text == "int64")
+      return P::make_TYPE_INT64("type_int64", Loc);
+    if (Text == "float")
+      return P::make_TYPE_FLOAT("type_float", Loc);
+    if (Text == "double")
+      return P::make_TYPE_DOUBLE("type_double", Loc);
+    if (Text == "string")
+      return P::make_TYPE_STRING("type_string", Loc);
+    if (Text == "bool")
+      return P::make_TYPE_BOOL("type_bool", Loc);
+  }
+
+  return P::make_IDENTIFIER(Drv.strings.get(Text), Loc);
+}
+
+yy::parser::symbol_type FastLexer::lexNumber(const char *Begin) {
+  const Kernels &K = getKernels();
+  Cur = K.Skip(Begin + 1, End, CharClass::Digit);
+
+  // A fraction or an exponent makes a floating point literal. Either must
+  // have digits, as in the flex scanner; "1." and "1e" end after the 1.
+  bool IsFloat = false;
+  if (End - Cur >= 2 && Cur[0] == '.' && isDigit(Cur[1])) {
+    Cur = K.Skip(Cur + 2, End, CharClass::Digit);
+    IsFloat = true;
+  }
+  if (Cur != End && (*Cur == 'e' || *Cur == 'E')) {
+    const char *Exp = Cur + 1;
+    if (Exp != End && (*Exp == '+' || *Exp == '-'))
+      ++Exp;
+    if (Exp != End && isDigit(*Exp)) {
+      Cur = K.Skip(Exp + 1, End, CharClass::Digit);
+      IsFloat = true;
+    }
+  }
+
+  if (IsFloat)
+    return lexFloat(Begin);
+
+  if (Cur != End && (*Cur == 'l' || *Cur == 'L')) {
+    auto Loc = getLocation(Begin, ++Cur);
+    std::string Text(Begin, Cur - 1);
+    errno = 0;
+    long long Value = strtoll(Text.c_str(), nullptr, 10);
+    if (errno == ERANGE)
+      throw P::syntax_error(Loc, "integer is out of ranges: " +
+                                     std::string(Begin, Cur));
+    return P::make_INT64_NUMBER(Value, Loc);
+  }
+
+  auto Loc = getLocation(Begin, Cur);
+
+  uint64_t Value = 0;
+  for (const char *D = Begin; D != Cur; ++D) {
+    Value = Value * 10 + (*D - '0');
+    if (Value > INT_MAX)
+      throw P::syntax_error(Loc, "integer is out of ranges: " +
+                                     std::string(Begin, Cur));
+  }
+
+  return P::make_NUMBER(int(Value), Loc);
+}
+
+yy::parser::symbol_type FastLexer::lexFloat(const char *Begin) {
+  std::string Text(Begin, Cur);
+  bool IsFloat = Cur != End && (*Cur == 'f' || *Cur == 'F');
+  if (IsFloat)
+    ++Cur;
+  auto Loc = getLocation(Begin, Cur);
+
+  errno = 0;
+  double Value = strtod(Text.c_str(), nullptr);
+  if (IsFloat) {
+    if (!std::isfinite(Value) || Value > FLT_MAX)
+      throw P::syntax_error(Loc, "float is out of ranges: " +
+                                     std::string(Begin, Cur));
+    return P::make_FLOAT_NUMBER(Value, Loc);
+  }
+
+  if (errno == ERANGE && std::isinf(Value))
+    throw P::syntax_error(Loc, "double is out of ranges: " +
+                                   std::string(Begin, Cur));
+  return P::make_DOUBLE_NUMBER(Value, Loc);
+}
+
+yy::parser::symbol_type FastLexer::lexString(const char *Begin) {
+  const Kernels &K = getKernels();
+  const char *S = Begin + 1;
+
+  for (;;) {
+    S = K.Skip(S, End, CharClass::StringBody);
+    if (S == End)
+      break;
+
+    if (*S == '"') {
+      Cur = S + 1;
+      llvm::StringRef Text(Begin, Cur - Begin);
+      return P::make_STRING_LITERAL(Drv.intern_literal(Text),
+                                    getLocation(Begin, Cur));
+    }
+
+    // An escape; as in flex's \\. it does not extend over a newline.
+    if (End - S < 2 || S[1] == '\n')
+      break;
+    S += 2;
+  }
+
+  // Without its closing quote the literal does not match, and flex falls
+  // back to the lone quote token.
+  Cur = Begin + 1;
+  return P::make_QMARK(getLocation(Begin, Cur));
+}
+
+yy::parser::symbol_type FastLexer::lexPunctuation(const char *Begin) {
+  char Next = End - Begin >= 2 ? Begin[1] : '\0';
+  Cur = Begin + 1;
+
+  auto Two = [&] {
+    Cur = Begin + 2;
+    return getLocation(Begin, Cur);
+  };
+
+  switch (*Begin) {
+  case ';':
+    return P::make_SEMICOLON(getLocation(Begin, Cur));
+  case ':':
+    return P::make_COLON(getLocation(Begin, Cur));
+  case '-':
+    return P::make_MINUS(getLocation(Begin, Cur));
+  case '+':
+    return P::make_PLUS(getLocation(Begin, Cur));
+  case '*':
+    return P::make_STAR(getLocation(Begin, Cur));
+  case '%':
+    return P::make_MOD(getLocation(Begin, Cur));
+  case '/':
+    return P::make_SLASH(getLocation(Begin, Cur));
+  case '(':
+    return P::make_LPAREN(getLocation(Begin, Cur));
+  case ')':
+    return P::make_RPAREN(getLocation(Begin, Cur));
+  case '[':
+    return P::make_LBRACKET(getLocation(Begin, Cur));
+  case ']':
+    return P::make_RBRACKET(getLocation(Begin, Cur));
+  case '{':
+    return P::make_LBRACE(getLocation(Begin, Cur));
+  case '}':
+    return P::make_RBRACE(getLocation(Begin, Cur));
+  case ',':
+    return P::make_COMMA(getLocation(Begin, Cur));
+  case '@':
+    return P::make_AT(getLocation(Begin, Cur));
+  case '=':
+    if (Next == '=')
+      return P::make_EQ(Two());
+    return P::make_ASSIGN(getLocation(Begin, Cur));
+  case '!':
+    if (Next == '=')
+      return P::make_DIFF(Two());
+    return P::make_NOT(getLocation(Begin, Cur));
+  case '<':
+    if (Next == '=')
+      return P::make_LTEQ(Two());
+    return P::make_LT(getLocation(Begin, Cur));
+  case '>':
+    if (Next == '=')
+      return P::make_GTEQ(Two());
+    return P::make_GT(getLocation(Begin, Cur));
+  case '|':
+    if (Next == '|')
+      return P::make_OR(Two());
+    break;
+  case '&':
+    if (Next == '&')
+      return P::make_AND(Two());
+    break;
+  }
+
+  throw P::syntax_error(getLocation(Begin, Cur),
+                        "invalid character: " + std::string(Begin, Cur));
+}
@@ -0,0 +1,115 @@
+#include "JIT.hh"
+#include "Log.hh"
+#include "grace_rt.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdio>
+
+using namespace llvm;
+using namespace grace;
+
+static int reportError(Error Err) {
+  std::string Message;
+  raw_string_ostream OS(Message);
+  logAllUnhandledErrors(std::move(Err), OS, "grace: ");
+  Log::message() << OS.str();
+  return -1;
+}
+
+int grace::runJIT(std::vector<OwnedModule> Modules,
+                  std::vector<std::unique_ptr<MemoryBuffer>> Objects,
+                  const Options &Opts) {
+  // Build the same target the modules were optimized for.
+  orc::JITTargetMachineBuilder JTMB((Triple(sys::getDefaultTargetTriple())));
+  JTMB.setCPU(Opts.CPU);
+  JTMB.addFeatures(SubtargetFeatures(Opts.Features).getFeatures());
+  JTMB.setCodeGenOptLevel(getCodeGenOptLevel(Opts.Opt));
+
+  auto DL = JTMB.getDefaultDataLayoutForTarget();
+  if (!DL)
+    return reportError(DL.takeError());
+
+  auto J = orc::LLJIT::Create(std::move(JTMB), *DL);
+  if (!J)
+    return reportError(J.takeError());
+
+  // Resolve anything the module does not define (printf, scanf) against the
+  // symbols already loaded in this process.
+  auto ProcessSymbols =
+      orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(*DL);
+  if (!ProcessSymbols)
+    return reportError(ProcessSymbols.takeError());
+  (*J)->getMainJITDylib().setGenerator(std::move(*ProcessSymbols));
+
+  // The runtime is linked into grace statically, so its symbols are not
+  // exported by the process and are handed to the JIT one by one.
+  orc::MangleAndInterner Mangle((*J)->getExecutionSession(), *DL);
+  orc::SymbolMap Runtime;
+  auto Define = [&](StringRef Name, void *Address) {
+    Runtime[Mangle(Name)] = JITEvaluatedSymbol(
+        pointerToJITTargetAddress(Address), JITSymbolFlags::Exported);
+  };
+  Define("grace_write_int", (void *)&grace_write_int);
+  Define("grace_write_int64", (void *)&grace_write_int64);
+  Define("grace_write_float", (void *)&grace_write_float);
+  Define("grace_write_double", (void *)&grace_write_double);
+  Define("grace_write_bool", (void *)&grace_write_bool);
+  Define("grace_write_str", (void *)&grace_write_str);
+  Define("grace_write_chars", (void *)&grace_write_chars);
+  Define("grace_flush", (void *)&grace_flush);
+  Define("grace_read_int", (void *)&grace_read_int);
+  Define("grace_read_int64", (void *)&grace_read_int64);
+  Define("grace_read_float", (void *)&grace_read_float);
+  Define("grace_read_double", (void *)&grace_read_double);
+  Define("grace_read_bool", (void *)&grace_read_bool);
+  Define("grace_read_str", (void *)&grace_read_str);
+  Define("grace_str_concat", (void *)&grace_str_concat);
+  Define("grace_str_compare", (void *)&grace_str_compare);
+  Define("grace_str_equal", (void *)&grace_str_equal);
+
+  if (auto Err = (*J)->getMainJITDylib().define(
+          orc::absoluteSymbols(std::move(Runtime))))
+    return reportError(std::move(Err));
+
+  for (auto &Module : Modules) {
+    Module.first->setDataLayout(*DL);
+    if (auto Err = (*J)->addIRModule(orc::ThreadSafeModule(
+            std::move(Module.first), std::move(Module.second))))
+      return reportError(std::move(Err));
+  }
+
+  for (auto &Object : Objects)
+    if (auto Err = (*J)->addObjectFile(std::move(Object)))
+      return reportError(std::move(Err));
+
+  if (auto Err = (*J)->runConstructors())
+    return reportError(std::move(Err));
+
+  auto MainSym = (*J)->lookup("main");
+  if (!MainSym)
+    return reportError(MainSym.takeError());
+
+  auto Main = reinterpret_cast<int (*)()>(
+      static_cast<uintptr_t>(MainSym->getAddress()));
+  int Result = Main();
+
+  if (auto Err = (*J)->runDestructors())
+    return reportError(std::move(Err));
+
+  // The program shares stdio and the runtime's buffer with the compiler; make
+  // its output visible before any diagnostics that follow.
+  grace_flush();
+  fflush(stdout);
+
+  return Result;
+}
@@ -0,0 +1,191 @@
+#include "Linker.hh"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#ifdef GRACE_HAVE_LLD
+#include "lld/Common/Driver.h"
+#endif
+
+using namespace llvm;
+using namespace grace;
+
+namespace {
+
+// An object file handed to the linker by path. Objects linked in process live
+// in an anonymous memory file and never reach the disk; otherwise they go to
+// a uniquely named temporary file that is removed once the link is done.
+class LinkInput {
+  int FD = -1;
+  SmallString<128> Path;
+  bool Temporary = false;
+
+public:
+  LinkInput() = default;
+  LinkInput(const LinkInput &) = delete;
+  LinkInput &operator=(const LinkInput &) = delete;
+
+  ~LinkInput() {
+    if (FD >= 0)
+      close(FD);
+    if (Temporary)
+      sys::fs::remove(Path);
+  }
+
+  bool create(MemoryBufferRef Object, bool InMemory) {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    if (InMemory && (FD = memfd_create("grace.o", MFD_CLOEXEC)) >= 0) {
+      Path = "/proc/self/fd/" + std::to_string(FD);
+      return write(Object);
+    }
+#endif
+
+    if (auto EC = sys::fs::createTemporaryFile("grace", "o", FD, Path)) {
+      errs() << "cannot create temporary object file: " << EC.message()
+             << "\n";
+      return false;
+    }
+
+    Temporary = true;
+    return write(Object);
+  }
+
+  StringRef path() const { return Path; }
+
+private:
+  bool write(MemoryBufferRef Object) {
+    raw_fd_ostream OS(FD, /*shouldClose=*/false);
+    OS << Object.getBuffer();
+    OS.flush();
+
+    if (OS.has_error()) {
+      errs() << "cannot write object file " << Path << "\n";
+      OS.clear_error();
+      return false;
+    }
+
+    return true;
+  }
+};
+
+typedef std::vector<std::unique_ptr<LinkInput>> LinkInputList;
+
+} // namespace
+
+#ifdef GRACE_HAVE_LLD
+// The directory holding crt1.o, crti.o, crtn.o and libc for TT.
+static std::string findCRuntimeDir(const Triple &TT) {
+  std::string MultiArch = (TT.getArchName() + "-linux-gnu").str();
+  const std::string Candidates[] = {"/usr/lib/" + MultiArch,
+                                    "/lib/" + MultiArch, "/usr/lib64",
+                                    "/lib64", "/usr/lib", "/lib"};
+
+  for (const auto &Dir : Candidates)
+    if (sys::fs::exists(Dir + "/crt1.o"))
+      return Dir;
+
+  return "";
+}
+
+static const char *getDynamicLinker(const Triple &TT) {
+  switch (TT.getArch()) {
+  case Triple::x86_64:
+    return "/lib64/ld-linux-x86-64.so.2";
+  case Triple::x86:
+    return "/lib/ld-linux.so.2";
+  case Triple::aarch64:
+    return "/lib/ld-linux-aarch64.so.1";
+  default:
+    return nullptr;
+  }
+}
+
+static bool linkWithLLD(const LinkInputList &Inputs, StringRef Output,
+                        const Triple &TT) {
+  std::string LibDir = findCRuntimeDir(TT);
+  const char *DynamicLinker = getDynamicLinker(TT);
+
+  if (LibDir.empty() || !DynamicLinker) {
+    errs() << "cannot find the C runtime for " << TT.str() << "\n";
+    return false;
+  }
+
+  std::vector<std::string> Args = {"ld.lld",
+                                   "-o",
+                                   Output.str(),
+                                   "--eh-frame-hdr",
+                                   "-dynamic-linker",
+                                   DynamicLinker,
+                                   LibDir + "/crt1.o",
+                                   LibDir + "/crti.o"};
+  for (const auto &Input : Inputs)
+    Args.push_back(Input->path());
+  Args.push_back(GRACE_RUNTIME_LIBRARY);
+  Args.push_back("-L" + LibDir);
+  Args.push_back("-lc");
+  Args.push_back(LibDir + "/crtn.o");
+
+  std::vector<const char *> Argv;
+  for (const auto &Arg : Args)
+    Argv.push_back(Arg.c_str());
+
+  return lld::elf::link(Argv, /*CanExitEarly=*/false);
+}
+#endif
+
+static bool linkWithCC(const LinkInputList &Inputs, StringRef Output) {
+  auto CC = sys::findProgramByName("cc");
+  if (!CC) {
+    errs() << "cannot find a C compiler to link with: "
+           << CC.getError().message() << "\n";
+    return false;
+  }
+
+  std::vector<StringRef> Args = {*CC, "-o", Output};
+  for (const auto &Input : Inputs)
+    Args.push_back(Input->path());
+  Args.push_back(GRACE_RUNTIME_LIBRARY);
+
+  std::string ErrMsg;
+  if (sys::ExecuteAndWait(*CC, Args, None, {}, 0, 0, &ErrMsg) != 0) {
+    errs() << "linking " << Output << " failed";
+    if (!ErrMsg.empty())
+      errs() << ": " << ErrMsg;
+    errs() << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+bool grace::linkExecutable(ArrayRef<MemoryBufferRef> Objects, StringRef Output,
+                           const Triple &TT) {
+#ifdef GRACE_HAVE_LLD
+  bool InProcess = TT.isOSLinux();
+#else
+  bool InProcess = false;
+#endif
+
+  LinkInputList Inputs;
+  for (auto Object : Objects) {
+    Inputs.push_back(std::make_unique<LinkInput>());
+    if (!Inputs.back()->create(Object, InProcess))
+      return false;
+  }
+
+#ifdef GRACE_HAVE_LLD
+  if (InProcess)
+    return linkWithLLD(Inputs, Output, TT);
+#endif
+
+  return linkWithCC(Inputs, Output);
+}
@@ -0,0 +1,161 @@
+#include "Options.hh"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace grace;
+
+std::string Options::getCodegenFingerprint() const {
+  return "O" + std::to_string(static_cast<int>(Opt)) + ";cpu=" + CPU +
+         ";features=" + Features +
+         ";overflow=" + std::to_string(static_cast<int>(Overflow)) +
+         ";ssa=" + std::to_string(DirectSSA) +
+         ";bounds=" + std::to_string(BoundsCheck) +
+         ";fast-math=" + std::to_string(FastMath);
+}
+
+bool grace::parseOptLevel(const std::string &Arg, OptLevel &Level) {
+  if (Arg == "-O0")
+    Level = OptLevel::O0;
+  else if (Arg == "-O1")
+    Level = OptLevel::O1;
+  else if (Arg == "-O2")
+    Level = OptLevel::O2;
+  else if (Arg == "-O3")
+    Level = OptLevel::O3;
+  else if (Arg == "-Os")
+    Level = OptLevel::Os;
+  else
+    return false;
+
+  return true;
+}
+
+static void appendFeatures(std::string &List, llvm::StringRef New) {
+  if (!List.empty() && !New.empty())
+    List += ",";
+  List += New.str();
+}
+
+static void updateFeatures(Options &Opts) {
+  Opts.Features = Opts.HostFeatures;
+  appendFeatures(Opts.Features, Opts.ExplicitFeatures);
+}
+
+static void setCPU(Options &Opts, llvm::StringRef CPU) {
+  // Host features only belong to the host CPU; a later -mcpu= drops them.
+  Opts.HostFeatures.clear();
+
+  if (CPU != "native") {
+    Opts.CPU = CPU.str();
+    updateFeatures(Opts);
+    return;
+  }
+
+  Opts.CPU = llvm::sys::getHostCPUName().str();
+
+  llvm::StringMap<bool> HostFeatures;
+  if (llvm::sys::getHostCPUFeatures(HostFeatures)) {
+    llvm::SubtargetFeatures Features;
+    for (auto &Feature : HostFeatures)
+      Features.AddFeature(Feature.first(), Feature.second);
+    Opts.HostFeatures = Features.getString();
+  }
+  updateFeatures(Opts);
+}
+
+bool grace::parseTargetOption(const std::string &Arg, Options &Opts) {
+  llvm::StringRef Ref(Arg);
+
+  if (Ref.consume_front("-march=") || Ref.consume_front("-mcpu=")) {
+    setCPU(Opts, Ref);
+    return true;
+  }
+
+  if (Ref.consume_front("-mattr=")) {
+    appendFeatures(Opts.ExplicitFeatures,
+                   llvm::SubtargetFeatures(Ref).getString());
+    updateFeatures(Opts);
+    return true;
+  }
+
+  return false;
+}
+
+ArgResult grace::parseEmitKind(const std::string &Arg, EmitKind &Kind) {
+  llvm::StringRef Ref(Arg);
+  if (!Ref.consume_front("--emit="))
+    return ArgResult::NotMatched;
+
+  if (Ref == "exe")
+    Kind = EmitKind::Exe;
+  else if (Ref == "obj")
+    Kind = EmitKind::Obj;
+  else if (Ref == "asm")
+    Kind = EmitKind::Asm;
+  else if (Ref == "llvm")
+    Kind = EmitKind::LLVM;
+  else if (Ref == "bc")
+    Kind = EmitKind::BC;
+  else {
+    llvm::errs() << "unknown output kind '" << Ref
+                 << "', expected exe, obj, asm, llvm or bc\n";
+    return ArgResult::Invalid;
+  }
+
+  return ArgResult::Parsed;
+}
+
+ArgResult grace::parseOverflowKind(const std::string &Arg,
+                                  OverflowKind &Kind) {
+  llvm::StringRef Ref(Arg);
+  if (!Ref.consume_front("--overflow="))
+    return ArgResult::NotMatched;
+
+  if (Ref == "wrap")
+    Kind = OverflowKind::Wrap;
+  else if (Ref == "trap")
+    Kind = OverflowKind::Trap;
+  else if (Ref == "undefined")
+    Kind = OverflowKind::Undefined;
+  else {
+    llvm::errs() << "unknown overflow behavior '" << Ref
+                 << "', expected wrap, trap or undefined\n";
+    return ArgResult::Invalid;
+  }
+
+  return ArgResult::Parsed;
+}
+
+ArgResult grace::parseLexerKind(const std::string &Arg, LexerKind &Kind) {
+  llvm::StringRef Ref(Arg);
+  if (!Ref.consume_front("--lexer="))
+    return ArgResult::NotMatched;
+
+  if (Ref == "flex")
+    Kind = LexerKind::Flex;
+  else if (Ref == "fast")
+    Kind = LexerKind::Fast;
+  else {
+    llvm::errs() << "unknown lexer '" << Ref << "', expected flex or fast\n";
+    return ArgResult::Invalid;
+  }
+
+  return ArgResult::Parsed;
+}
+
+llvm::CodeGenOpt::Level grace::getCodeGenOptLevel(OptLevel Level) {
+  switch (Level) {
+  case OptLevel::O0:
+    return llvm::CodeGenOpt::None;
+  case OptLevel::O1:
+    return llvm::CodeGenOpt::Less;
+  case OptLevel::O2:
+  case OptLevel::Os:
+    return llvm::CodeGenOpt::Default;
+  case OptLevel::O3:
+    return llvm::CodeGenOpt::Aggressive;
+  }
+}
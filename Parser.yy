@@ -1,5 +1,5 @@
 %skeleton "lalr1.cc"
-%require "3.0.4"
+%require "3.6"
 %defines
 
 %define api.token.constructor
@@ -11,6 +11,8 @@
   #include "AST.hh"
   #include "BinOp.hh"
   #include "Type.hh"
+  #include "StringPool.hh"
+  #include "llvm/ADT/StringRef.h"
   class Driver;
 
   using namespace grace;
@@ -29,6 +31,7 @@
 
 %code { 
   #include "Driver.hh"
+  #include "Log.hh"
 }
 
 %define api.token.prefix {TOK_}
@@ -59,9 +62,11 @@
   GTEQ ">="
   COMMA ","
   QMARK "\""
+  AT "@"
 
   VAR "var"
   DEF "def"
+  EXPORT "export"
   TRUE "true"
   FALSE "false"
   IF "if"
@@ -86,16 +91,25 @@
 %right NOT
 
 
-%token <std::string> IDENTIFIER "identifier"
+%token <grace::Identifier> IDENTIFIER "identifier"
 %token <int> NUMBER "number"
+%token <int64_t> INT64_NUMBER "int64 number"
+%token <double> FLOAT_NUMBER "float number"
+%token <double> DOUBLE_NUMBER "double number"
 %token <bool> BOOL_LITERAL "bool literal"
 
 %token <std::string> TYPE_INT "type_int"
+%token <std::string> TYPE_INT64 "type_int64"
+%token <std::string> TYPE_FLOAT "type_float"
+%token <std::string> TYPE_DOUBLE "type_double"
 %token <std::string> TYPE_STRING "type_string"
 %token <std::string> TYPE_BOOL "type_bool"
-%token <std::string> STRING_LITERAL
+%token <llvm::StringRef> STRING_LITERAL
 
-%type <StmtNode*> stmt func_decl proc_decl if_then_else_stmt while_stmt for_stmt return_stmt
+%type <StmtNode*> stmt proc_decl if_then_else_stmt return_stmt
+%type <FuncDeclNode*> func_decl
+%type <LoopNode*> loop_stmt while_stmt for_stmt
+%type <LoopHint> loop_hint
 %type <AssignNode *> assign_stmt assign_expr
 %type <BlockNode*> stmts block
 
@@ -108,10 +122,13 @@
 %type <LiteralNode *> literal
 %type <ParamList*> param_list
 %type <Param*> param
-%type <ExprList*> expr_list
+%type <ExprList*> expr_list read_list
+%type <ExprNode *> read_target
 
 
 %printer { yyoutput << $$; } <*>;
+%printer { yyoutput << $$.str(); } <llvm::StringRef>;
+%printer { yyoutput << "@" << $$.Name; } <LoopHint>;
 
 %start program;
 %%
@@ -119,7 +136,7 @@
 program: stmts { drv.program = $1; }
        ;
 
-stmts: stmt { $$ = new BlockNode(@$); $$->Stmts.push_back($1); }
+stmts: stmt { $$ = drv.arena.make<BlockNode>(@$, drv.arena); $$->Stmts.push_back($1); }
       | stmts stmt { $1->Stmts.push_back($2); $$ = $1; }
       ;
 
@@ -127,33 +144,31 @@ stmt: var_decl { $$ = $1; }
     | func_decl { $$ = $1; }
     | proc_decl { $$ = $1; }
 	| if_then_else_stmt { $$ = $1; }
-    | while_stmt { $$ = $1; }
-    | for_stmt {$$ = $1; }
+    | loop_stmt { $$ = $1; }
     | return_stmt { $$ = $1; }
-    | SKIP SEMICOLON { $$ = new SkipNode(@1); }
-    | STOP SEMICOLON { $$ = new StopNode(@1); }
+    | SKIP SEMICOLON { $$ = drv.arena.make<SkipNode>(@1); }
+    | STOP SEMICOLON { $$ = drv.arena.make<StopNode>(@1); }
     | assign_stmt { $$ = $1; }
-    | WRITE expr_list SEMICOLON { $$ = new WriteNode(@1, $2); }
+    | WRITE expr_list SEMICOLON { $$ = drv.arena.make<WriteNode>(@1, $2); }
+    | READ read_list SEMICOLON { $$ = drv.arena.make<ReadNode>(@1, $2); }
 //    | call_expr SEMICOLON { $$ =  }
-  //  | READ var_expr SEMICOLON { $$ = new ReadNode(@1 $2); }
     ;
 
-if_then_else_stmt: IF LPAREN expr RPAREN block { $$ = new IfThenElseNode(@$, $3, $5, NULL); }
-				| IF LPAREN expr RPAREN block ELSE block { $$ = new IfThenElseNode(@$, $3, $5, $7); }
+if_then_else_stmt: IF LPAREN expr RPAREN block { $$ = drv.arena.make<IfThenElseNode>(@$, $3, $5, nullptr); }
+				| IF LPAREN expr RPAREN block ELSE block { $$ = drv.arena.make<IfThenElseNode>(@$, $3, $5, $7); }
         ;
 
-var_decl: VAR spec_var_list COLON data_type SEMICOLON { $$ = new VarDeclNodeListStmt(@$);
+var_decl: VAR spec_var_list COLON data_type SEMICOLON { $$ = drv.arena.make<VarDeclNodeListStmt>(@$, drv.arena);
                                                         for (auto spec : *$2) {
+                                                          auto Ty = spec->IsArray ? grace::Type::arrayTy($4, spec->Size) : $4;
                                                           $$->varDeclList.push_back(
-                                                            new VarDeclNode(spec->loc, spec->Id, spec->Assign, $4)
+                                                            drv.arena.make<VarDeclNode>(spec->loc, spec->Id, spec->Assign, Ty)
                                                           );
-                                                          delete spec;
                                                         }
-                                                        delete $2;
                                                       }
        ;
 
-spec_var_list: spec_var { $$ = new SpecVarList(); $$->push_back($1); }
+spec_var_list: spec_var { $$ = drv.arena.makeList<SpecVarList>(); $$->push_back($1); }
              | spec_var_list COMMA spec_var { $1->push_back($3); $$ = $1; }
              ;
 
@@ -161,84 +176,118 @@ spec_var: spec_var_simple { $$ = $1; }
        | spec_var_simple_init { $$ = $1; }
        ;
 
-spec_var_simple: IDENTIFIER { $$ = new SpecVar(@$, $1, NULL); }
+spec_var_simple: IDENTIFIER { $$ = drv.arena.make<SpecVar>(@$, $1, nullptr); }
+              | IDENTIFIER LBRACKET NUMBER RBRACKET { $$ = drv.arena.make<SpecVar>(@$, $1, unsigned($3)); }
               ;
 
-spec_var_simple_init: IDENTIFIER ASSIGN expr { $$ = new SpecVar(@$, $1, new AssignNode(@2, $1, $3)); }
+spec_var_simple_init: IDENTIFIER ASSIGN expr { $$ = drv.arena.make<SpecVar>(@$, $1, drv.arena.make<AssignNode>(@2, $1, $3)); }
                     ;
 
-literal: STRING_LITERAL { $$ = new LiteralStringNode(@$, $1); }
-       | NUMBER { $$ = new LiteralIntNode(@$, $1); }
-       | BOOL_LITERAL { $$ = new LiteralBoolNode(@$, $1); };
-
-data_type: TYPE_INT { $$ = new grace::IntType(); }
-    | TYPE_STRING { $$ = new grace::StringType(); }
-    | TYPE_BOOL { $$ = new grace::BoolType(); }
+literal: STRING_LITERAL { $$ = drv.arena.make<LiteralStringNode>(@$, $1); }
+       | NUMBER { $$ = drv.arena.make<LiteralIntNode>(@$, $1); }
+       | INT64_NUMBER { $$ = drv.arena.make<LiteralInt64Node>(@$, $1); }
+       | FLOAT_NUMBER { $$ = drv.arena.make<LiteralFloatNode>(@$, $1, false); }
+       | DOUBLE_NUMBER { $$ = drv.arena.make<LiteralFloatNode>(@$, $1, true); }
+       | BOOL_LITERAL { $$ = drv.arena.make<LiteralBoolNode>(@$, $1); };
+
+data_type: TYPE_INT { $$ = grace::Type::intTy(); }
+    | TYPE_INT64 { $$ = grace::Type::int64Ty(); }
+    | TYPE_FLOAT { $$ = grace::Type::floatTy(); }
+    | TYPE_DOUBLE { $$ = grace::Type::doubleTy(); }
+    | TYPE_STRING { $$ = grace::Type::strTy(); }
+    | TYPE_BOOL { $$ = grace::Type::boolTy(); }
     ;
 
-func_decl: DEF IDENTIFIER LPAREN RPAREN COLON data_type block { $$ = new FuncDeclNode(@$, $2, $6, new ParamList(), $7); }
-    | DEF IDENTIFIER LPAREN param_list RPAREN COLON data_type block { $$ = new FuncDeclNode(@$, $2, $7, $4, $8); }
+func_decl: DEF IDENTIFIER LPAREN RPAREN COLON data_type block { $$ = drv.arena.make<FuncDeclNode>(@$, $2, $6, drv.arena.makeList<ParamList>(), $7); }
+    | DEF IDENTIFIER LPAREN param_list RPAREN COLON data_type block { $$ = drv.arena.make<FuncDeclNode>(@$, $2, $7, $4, $8); }
+    | EXPORT func_decl { $$ = $2; $$->setExported(); }
     ;
 
-proc_decl: DEF IDENTIFIER LPAREN RPAREN block { $$ = new ProcDeclNode(@$, $2, new ParamList(), $5); };
-  | DEF IDENTIFIER LPAREN param_list RPAREN block { $$ = new ProcDeclNode(@$, $2, $4, $6); };
+proc_decl: DEF IDENTIFIER LPAREN RPAREN block { $$ = drv.arena.make<ProcDeclNode>(@$, $2, drv.arena.makeList<ParamList>(), $5); };
+  | DEF IDENTIFIER LPAREN param_list RPAREN block { $$ = drv.arena.make<ProcDeclNode>(@$, $2, $4, $6); };
 
-param_list: param { $$ = new ParamList(); $$->push_back($1); }
+param_list: param { $$ = drv.arena.makeList<ParamList>(); $$->push_back($1); }
   | param_list COMMA param { $1->push_back($3); $$ = $1; }
   ;
 
-param: IDENTIFIER COLON data_type { $$ = new Param(@$, $1, $3); }
+param: IDENTIFIER COLON data_type { $$ = drv.arena.make<Param>(@$, $1, $3); }
+  | IDENTIFIER LBRACKET RBRACKET COLON data_type { $$ = drv.arena.make<Param>(@$, $1, grace::Type::arrayTy($5, 0)); }
+  | IDENTIFIER LBRACKET NUMBER RBRACKET COLON data_type { $$ = drv.arena.make<Param>(@$, $1, grace::Type::arrayTy($6, $3)); }
   ;
 
 block: LBRACE stmts RBRACE { $$ = $2; }
-     | LBRACE RBRACE { $$ = new BlockNode(@$); };
+     | LBRACE RBRACE { $$ = drv.arena.make<BlockNode>(@$, drv.arena); };
 
-expr: IDENTIFIER { $$ = new VariableExprNode(@$, $1); }
+expr: IDENTIFIER { $$ = drv.arena.make<VariableExprNode>(@$, $1); }
+    | IDENTIFIER LBRACKET expr RBRACKET { $$ = drv.arena.make<IndexExprNode>(@$, $1, $3); }
     | literal { $$ = $1; }
-    | NOT expr { $$ = new ExprNotNode(@$, $2); }
-    | MINUS expr { $$ = new ExprNegativeNode(@$, $2); }
-    | expr PLUS expr { $$ = new ExprOperationNode(@$, $1, BinOp::PLUS, $3); }
-    | expr MINUS expr { $$ = new ExprOperationNode(@$, $1, BinOp::MINUS, $3); }
-    | expr STAR expr { $$ = new ExprOperationNode(@$, $1, BinOp::TIMES, $3); }
-    | expr SLASH expr { $$ = new ExprOperationNode(@$, $1, BinOp::DIV, $3); }
-    | expr MOD expr { $$ = new ExprOperationNode(@$, $1, BinOp::MOD, $3); }
-    | expr LT expr { $$ = new ExprOperationNode(@$, $1, BinOp::LT, $3); }
-    | expr LTEQ expr { $$ = new ExprOperationNode(@$, $1, BinOp::LTEQ, $3); }
-    | expr GT expr { $$ = new ExprOperationNode(@$, $1, BinOp::GT, $3); }
-    | expr GTEQ expr { $$ = new ExprOperationNode(@$, $1, BinOp::GTEQ, $3); }
-    | expr EQ expr { $$ = new ExprOperationNode(@$, $1, BinOp::EQ, $3); }
-    | expr DIFF expr { $$ = new ExprOperationNode(@$, $1, BinOp::DIFF, $3); }
-    | expr AND expr { $$ = new ExprOperationNode(@$, $1, BinOp::AND, $3); }
-    | expr OR expr { $$ = new ExprOperationNode(@$, $1, BinOp::OR, $3); }
+    | NOT expr { $$ = drv.arena.make<ExprNotNode>(@$, $2); }
+    | MINUS expr { $$ = drv.arena.make<ExprNegativeNode>(@$, $2); }
+    | expr PLUS expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::PLUS, $3); }
+    | expr MINUS expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::MINUS, $3); }
+    | expr STAR expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::TIMES, $3); }
+    | expr SLASH expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::DIV, $3); }
+    | expr MOD expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::MOD, $3); }
+    | expr LT expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::LT, $3); }
+    | expr LTEQ expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::LTEQ, $3); }
+    | expr GT expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::GT, $3); }
+    | expr GTEQ expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::GTEQ, $3); }
+    | expr EQ expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::EQ, $3); }
+    | expr DIFF expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::DIFF, $3); }
+    | expr AND expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::AND, $3); }
+    | expr OR expr { $$ = drv.arena.make<ExprOperationNode>(@$, $1, BinOp::OR, $3); }
     | LPAREN expr RPAREN { $$ = $2; }
     | call_expr { $$ = $1; }
+    | data_type LPAREN expr RPAREN { $$ = drv.arena.make<ConvertExprNode>(@$, $1, $3); }
     ;
 
-expr_list: expr { $$ = new ExprList(); $$->push_back($1); }
+expr_list: expr { $$ = drv.arena.makeList<ExprList>(); $$->push_back($1); }
     | expr_list COMMA expr { $1->push_back($3); $$ = $1; }
     ;
 
-call_expr: IDENTIFIER LPAREN RPAREN { $$ = new CallExprNode(@$, $1, new ExprList()); }
-          | IDENTIFIER LPAREN expr_list RPAREN { $$ = new CallExprNode(@$, $1, $3); }
+read_list: read_target { $$ = drv.arena.makeList<ExprList>(); $$->push_back($1); }
+    | read_list COMMA read_target { $1->push_back($3); $$ = $1; }
+    ;
+
+read_target: IDENTIFIER { $$ = drv.arena.make<VariableExprNode>(@$, $1); }
+    | IDENTIFIER LBRACKET expr RBRACKET { $$ = drv.arena.make<IndexExprNode>(@$, $1, $3); }
+    ;
+
+call_expr: IDENTIFIER LPAREN RPAREN { $$ = drv.arena.make<CallExprNode>(@$, $1, drv.arena.makeList<ExprList>()); }
+          | IDENTIFIER LPAREN expr_list RPAREN { $$ = drv.arena.make<CallExprNode>(@$, $1, $3); }
+          ;
+
+loop_stmt: while_stmt { $$ = $1; }
+         | for_stmt { $$ = $1; }
+         | loop_hint loop_stmt { $2->Hints.insert($2->Hints.begin(), $1); $$ = $2; }
+         ;
+
+loop_hint: AT IDENTIFIER { $$ = LoopHint(@$, $2); }
+          | AT IDENTIFIER LPAREN NUMBER RPAREN { $$ = LoopHint(@$, $2, $4); }
           ;
 
-while_stmt: WHILE LPAREN expr RPAREN block { $$ = new WhileNode(@$, $3, $5); };
+while_stmt: WHILE LPAREN expr RPAREN block { $$ = drv.arena.make<WhileNode>(@$, $3, $5); };
 
-for_stmt: FOR LPAREN assign_expr SEMICOLON expr SEMICOLON assign_expr RPAREN block { $$ = new ForNode(@$, $3, $5, $7, $9); };
+for_stmt: FOR LPAREN assign_expr SEMICOLON expr SEMICOLON assign_expr RPAREN block { $$ = drv.arena.make<ForNode>(@$, $3, $5, $7, $9); };
 
-return_stmt: RETURN SEMICOLON { $$ = new ReturnNode(@$, nullptr); }
-            | RETURN expr SEMICOLON { $$ = new ReturnNode(@$, $2); };
+return_stmt: RETURN SEMICOLON { $$ = drv.arena.make<ReturnNode>(@$, nullptr); }
+            | RETURN expr SEMICOLON { $$ = drv.arena.make<ReturnNode>(@$, $2); };
 
-assign_expr: IDENTIFIER ASSIGN expr { $$ = new AssignNode(@$, $1, $3); }
-            | IDENTIFIER PLUS ASSIGN expr { $$ = new CompoundAssignNode(@$, $1, BinOp::PLUS, $4); }
-            | IDENTIFIER MINUS ASSIGN expr { $$ = new CompoundAssignNode(@$, $1, BinOp::MINUS, $4); }
-            | IDENTIFIER STAR ASSIGN expr { $$ = new CompoundAssignNode(@$, $1, BinOp::TIMES, $4); }
-            | IDENTIFIER SLASH ASSIGN expr { $$ = new CompoundAssignNode(@$, $1, BinOp::DIV, $4); }
+assign_expr: IDENTIFIER ASSIGN expr { $$ = drv.arena.make<AssignNode>(@$, $1, $3); }
+            | IDENTIFIER PLUS ASSIGN expr { $$ = drv.arena.make<CompoundAssignNode>(@$, $1, BinOp::PLUS, $4); }
+            | IDENTIFIER MINUS ASSIGN expr { $$ = drv.arena.make<CompoundAssignNode>(@$, $1, BinOp::MINUS, $4); }
+            | IDENTIFIER STAR ASSIGN expr { $$ = drv.arena.make<CompoundAssignNode>(@$, $1, BinOp::TIMES, $4); }
+            | IDENTIFIER SLASH ASSIGN expr { $$ = drv.arena.make<CompoundAssignNode>(@$, $1, BinOp::DIV, $4); }
+            | IDENTIFIER LBRACKET expr RBRACKET ASSIGN expr { $$ = drv.arena.make<AssignNode>(@$, $1, $3, $6); }
+            | IDENTIFIER LBRACKET expr RBRACKET PLUS ASSIGN expr { $$ = drv.arena.make<CompoundAssignNode>(@$, $1, $3, BinOp::PLUS, $7); }
+            | IDENTIFIER LBRACKET expr RBRACKET MINUS ASSIGN expr { $$ = drv.arena.make<CompoundAssignNode>(@$, $1, $3, BinOp::MINUS, $7); }
+            | IDENTIFIER LBRACKET expr RBRACKET STAR ASSIGN expr { $$ = drv.arena.make<CompoundAssignNode>(@$, $1, $3, BinOp::TIMES, $7); }
+            | IDENTIFIER LBRACKET expr RBRACKET SLASH ASSIGN expr { $$ = drv.arena.make<CompoundAssignNode>(@$, $1, $3, BinOp::DIV, $7); }
             ;
 
 assign_stmt: assign_expr SEMICOLON { $$ = $1; };
 %%
 
 void yy::parser::error(const location_type &l, const std::string &m) {
-  std::cerr << l << ": " << m << '\n';
+  Log::error(l.begin) << m << "\n";
 }
@@ -0,0 +1,112 @@
+#include "SSABuilder.hh"
+#include "AST.hh"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+
+using namespace llvm;
+using namespace grace;
+
+static PHINode *createPhi(llvm::Type *Ty, const Variable *V,
+                          BasicBlock *BB) {
+  // Phis go first, ahead of whatever the block already holds.
+  if (BB->empty())
+    return PHINode::Create(Ty, 2, V->Id.str(), BB);
+  return PHINode::Create(Ty, 2, V->Id.str(), &BB->front());
+}
+
+Value *SSABuilder::read(const Variable *V, llvm::Type *Ty, BasicBlock *BB) {
+  auto It = CurrentDef.find({V, BB});
+  if (It != CurrentDef.end() && It->second)
+    return It->second;
+  return readRecursive(V, Ty, BB);
+}
+
+Value *SSABuilder::readRecursive(const Variable *V, llvm::Type *Ty,
+                                 BasicBlock *BB) {
+  Value *Val;
+
+  if (!Sealed.count(BB)) {
+    auto Phi = createPhi(Ty, V, BB);
+    IncompletePhis[BB].push_back({V, Phi});
+    Val = Phi;
+  } else if (auto Pred = BB->getSinglePredecessor()) {
+    Val = read(V, Ty, Pred);
+  } else if (pred_empty(BB)) {
+    Val = UndefValue::get(Ty);
+  } else {
+    // Record the phi first to break cycles through loops.
+    auto Phi = createPhi(Ty, V, BB);
+    write(V, BB, Phi);
+    Val = addPhiOperands(V, Phi);
+  }
+
+  write(V, BB, Val);
+  return Val;
+}
+
+Value *SSABuilder::addPhiOperands(const Variable *V, PHINode *Phi) {
+  BasicBlock *BB = Phi->getParent();
+
+  // Reading from the predecessors may remove phis Phi already uses, which
+  // must not remove Phi itself while it is only partly filled in.
+  Filling.insert(Phi);
+  for (auto Pred : predecessors(BB))
+    Phi->addIncoming(read(V, Phi->getType(), Pred), Pred);
+  Filling.erase(Phi);
+
+  return tryRemoveTrivialPhi(Phi);
+}
+
+Value *SSABuilder::tryRemoveTrivialPhi(PHINode *Phi) {
+  Value *Same = nullptr;
+  for (Value *Op : Phi->incoming_values()) {
+    if (Op == Same || Op == Phi)
+      continue;
+    if (Same)
+      return Phi;
+    Same = Op;
+  }
+
+  // Unreachable, or only reachable from itself.
+  if (!Same)
+    Same = UndefValue::get(Phi->getType());
+
+  // Removing Phi may make the phis using it trivial in turn. They are held
+  // by tracking handles, since the recursion may replace them first.
+  SmallVector<WeakTrackingVH, 8> Users;
+  for (User *U : Phi->users())
+    if (U != Phi && isa<PHINode>(U) && !Filling.count(cast<PHINode>(U)))
+      Users.push_back(U);
+
+  Phi->replaceAllUsesWith(Same);
+  Phi->eraseFromParent();
+
+  // Same may be one of those users and get replaced in turn.
+  WeakTrackingVH Result = Same;
+  for (auto &U : Users)
+    if (auto UserPhi = dyn_cast_or_null<PHINode>(U))
+      tryRemoveTrivialPhi(UserPhi);
+
+  return Result;
+}
+
+void SSABuilder::seal(BasicBlock *BB) {
+  if (!Sealed.insert(BB).second)
+    return;
+
+  auto It = IncompletePhis.find(BB);
+  if (It == IncompletePhis.end())
+    return;
+
+  auto Phis = std::move(It->second);
+  IncompletePhis.erase(It);
+  for (auto &Incomplete : Phis)
+    addPhiOperands(Incomplete.first, Incomplete.second);
+}
+
+void SSABuilder::clear() {
+  CurrentDef.clear();
+  IncompletePhis.clear();
+  Sealed.clear();
+  Filling.clear();
+}
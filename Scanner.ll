@@ -1,9 +1,12 @@
 %{
 #include <cerrno>
+#include <cfloat>
 #include <climits>
+#include <cmath>
 #include <cstdlib>
 #include <string>
 #include "Driver.hh"  
+#include "Log.hh"
 #include "Parser.hh"
 
 #undef yywrap
@@ -14,10 +17,12 @@
 #endif
 %}
 
-%option noyywrap nounput batch debug noinput
+%option reentrant noyywrap nounput batch debug noinput
 
 id [a-zA-Z_][a-zA-Z_0-9]*
 int [0-9]+
+exp [eE][-+]?[0-9]+
+float {int}"."{int}{exp}?|{int}{exp}
 blank [ \t]
 
 %{
@@ -38,6 +43,7 @@ loc.step();
 "if" return yy::parser::make_IF(loc);
 "else" return yy::parser::make_ELSE(loc);
 "def" return yy::parser::make_DEF(loc);
+"export" return yy::parser::make_EXPORT(loc);
 "var" return yy::parser::make_VAR(loc);
 "true" return yy::parser::make_BOOL_LITERAL(true, loc);
 "false" return yy::parser::make_BOOL_LITERAL(false, loc);
@@ -49,6 +55,9 @@ loc.step();
 "read" return yy::parser::make_READ(loc);
 
 "int" return yy::parser::make_TYPE_INT("type_int", loc);
+"int64" return yy::parser::make_TYPE_INT64("type_int64", loc);
+"float" return yy::parser::make_TYPE_FLOAT("type_float", loc);
+"double" return yy::parser::make_TYPE_DOUBLE("type_double", loc);
 "string" return yy::parser::make_TYPE_STRING("type_string", loc);
 "bool" return yy::parser::make_TYPE_BOOL("type_bool", loc);
 
@@ -56,7 +65,10 @@ loc.step();
 "//".* loc.step();
 [\n]+ loc.lines(yyleng); loc.step();
 
-\"(\\.|[^\\"])*\" return yy::parser::make_STRING_LITERAL(yytext, loc);
+\"(\\.|[^\\"])*\" {
+  return yy::parser::make_STRING_LITERAL(
+      drv.intern_literal(llvm::StringRef(yytext, yyleng)), loc);
+}
 
 ";" return yy::parser::make_SEMICOLON(loc);
 ":" return yy::parser::make_COLON(loc);
@@ -80,6 +92,7 @@ loc.step();
 ">" return yy::parser::make_GT(loc);
 ">=" return yy::parser::make_GTEQ(loc);
 "," return yy::parser::make_COMMA(loc);
+"@" return yy::parser::make_AT(loc);
 "\"" return yy::parser::make_QMARK(loc);
 "||" return yy::parser::make_OR(loc);
 "&&" return yy::parser::make_AND(loc);
@@ -93,7 +106,30 @@ loc.step();
     throw yy::parser::syntax_error (loc, "integer is out of ranges: " + std::string(yytext));
     return yy::parser::make_NUMBER(n, loc);
 }
-{id} return yy::parser::make_IDENTIFIER(yytext, loc);
+{int}[lL] {
+  errno = 0;
+  long long n = strtoll(yytext, NULL, 10);
+  if (errno == ERANGE)
+    throw yy::parser::syntax_error (loc, "integer is out of ranges: " + std::string(yytext));
+  return yy::parser::make_INT64_NUMBER(n, loc);
+}
+{float}[fF] {
+  double d = strtod(yytext, NULL);
+  if (!std::isfinite(d) || d > FLT_MAX)
+    throw yy::parser::syntax_error (loc, "float is out of ranges: " + std::string(yytext));
+  return yy::parser::make_FLOAT_NUMBER(d, loc);
+}
+{float} {
+  errno = 0;
+  double d = strtod(yytext, NULL);
+  if (errno == ERANGE && std::isinf(d))
+    throw yy::parser::syntax_error (loc, "double is out of ranges: " + std::string(yytext));
+  return yy::parser::make_DOUBLE_NUMBER(d, loc);
+}
+{id} {
+  return yy::parser::make_IDENTIFIER(
+      drv.strings.get(llvm::StringRef(yytext, yyleng)), loc);
+}
 <<EOF>> return yy::parser::make_END(loc);
 . {
   throw yy::parser::syntax_error (loc, "invalid character: " + std::string(yytext));
@@ -101,15 +137,22 @@ loc.step();
 %%
 
 void Driver::scan_begin() {
-  yy_flex_debug = trace_scanning;
-  if (file.empty() || file == "-")
-    yyin = stdin;
-  else if (!(yyin = fopen(file.c_str(), "r"))) {
-    std::cerr << "cannot open " << file << ": " << strerror(errno) << '\n';
-    exit(EXIT_FAILURE);
+  if (use_fast_lexer) {
+    fast_lexer.reset(new grace::FastLexer(*this, source->getBuffer()));
+    return;
   }
+
+  yylex_init(&scanner);
+  yyset_debug(trace_scanning, scanner);
+  // Scan the source in place; flex only needs the two NUL bytes after it.
+  yy_scan_buffer(source->getScanBuffer(), source->getScanSize(), scanner);
 }
 
 void Driver::scan_end() {
-  fclose(yyin);
+  // Also frees the buffer state created by yy_scan_buffer, but not the text.
+  if (scanner)
+    yylex_destroy(scanner);
+  scanner = nullptr;
+  fast_lexer.reset();
+  source.reset();
 }
@@ -0,0 +1,560 @@
+#include "Sema.hh"
+#include "llvm/Support/MathExtras.h"
+
+using namespace llvm;
+using namespace grace;
+
+Sema::Sema(StringPool &Names) : ST(Names) {
+  ST.enterScope();
+
+  // The C functions every Context declares.
+  declareFunction("printf", Type::intTy(), {Type::strTy()});
+  declareFunction("scanf", Type::intTy(), {Type::strTy()});
+
+  Likely = ST.set<FuncSymbol>("likely", nullptr, Type::boolTy(),
+                              std::vector<Type *>{Type::boolTy()});
+  Unlikely = ST.set<FuncSymbol>("unlikely", nullptr, Type::boolTy(),
+                                std::vector<Type *>{Type::boolTy()});
+  Length = ST.set<FuncSymbol>("length", nullptr, Type::intTy(),
+                              std::vector<Type *>{Type::strTy()});
+}
+
+void Sema::declareFunction(StringRef Name, Type *ReturnTy,
+                           const std::vector<Type *> &Args) {
+  ST.set<FuncSymbol>(Name, nullptr, ReturnTy, Args);
+}
+
+bool Sema::check(BlockNode &Program) {
+  // Code is only generated inside functions, so nothing but declarations
+  // may appear at the top level.
+  for (auto Stmt : Program.Stmts) {
+    if (dynamic_cast<FuncDeclNode *>(Stmt) ||
+        dynamic_cast<ProcDeclNode *>(Stmt) ||
+        dynamic_cast<VarDeclNodeListStmt *>(Stmt))
+      Stmt->check(*this);
+    else
+      error(Stmt->loc.begin) << "only functions, procedures and variables "
+                                "can be declared at the top level\n";
+  }
+
+  return Errors == 0;
+}
+
+void Sema::expect(ExprNode *E, Type *Expected) {
+  if (E->Ty && E->Ty != Expected)
+    error(E->loc.begin) << "'" << E->Ty->str() << "' is not convertible to '"
+                        << Expected->str() << "'\n";
+}
+
+void BlockNode::check(Sema &S) {
+  for (auto Stmt : Stmts)
+    Stmt->check(S);
+}
+
+void LiteralIntNode::check(Sema &S) { Ty = Type::intTy(); }
+
+void LiteralInt64Node::check(Sema &S) { Ty = Type::int64Ty(); }
+
+void LiteralFloatNode::check(Sema &S) {
+  Ty = IsDouble ? Type::doubleTy() : Type::floatTy();
+}
+
+void LiteralStringNode::check(Sema &S) { Ty = Type::strTy(); }
+
+void LiteralBoolNode::check(Sema &S) { Ty = Type::boolTy(); }
+
+void IfThenElseNode::check(Sema &S) {
+  Condition->check(S);
+  S.expect(Condition, Type::boolTy());
+
+  S.ST.enterScope();
+  Then->check(S);
+  S.ST.leaveScope();
+
+  if (Else) {
+    S.ST.enterScope();
+    Else->check(S);
+    S.ST.leaveScope();
+  }
+}
+
+// Check the parameters and body of a function or procedure. Parameters live
+// in the scope of the body.
+static void checkBody(Sema &S, Identifier Name, grace::Type *ReturnTy,
+                      ParamList &Args, BlockNode *Body) {
+  S.FuncName = Name;
+  S.ReturnTy = ReturnTy;
+  S.ReturnFound = false;
+
+  S.ST.enterScope();
+  for (auto Arg : Args)
+    S.ST.set<VariableSymbol>(Arg->Id, Arg);
+  Body->check(S);
+  S.ST.leaveScope();
+
+  S.FuncName = Identifier();
+}
+
+void FuncDeclNode::check(Sema &S) {
+  auto Existing = S.ST.get(Name);
+  if (Existing && Existing != S.Likely && Existing != S.Unlikely &&
+      Existing != S.Length) {
+    S.error(loc.begin) << "function " << Name << " already defined\n";
+    return;
+  }
+
+  std::vector<Type *> ArgsTy;
+  for (auto Arg : *Args)
+    ArgsTy.push_back(Arg->Ty);
+
+  // Bound before the body is checked, so the function may call itself.
+  S.ST.set<FuncSymbol>(Name, nullptr, ReturnTy, ArgsTy);
+
+  checkBody(S, Name, ReturnTy, *Args, Body);
+
+  if (!S.ReturnFound)
+    Log::warning(Body->loc.end)
+        << "expected a return statement inside function body, "
+           "but none was found.\n";
+}
+
+void ProcDeclNode::check(Sema &S) {
+  checkBody(S, Name, nullptr, *Args, Body);
+}
+
+void VarDeclNode::check(Sema &S) {
+  if (S.ST.get(Var.Id)) {
+    S.error(loc.begin) << "variable " << Var.Id << " already declared.\n";
+    return;
+  }
+
+  S.ST.set<VariableSymbol>(Var.Id, &Var);
+  Var.Global = !S.FuncName;
+
+  if (Var.Ty->isArrayTy() && !Var.Ty->getArraySize())
+    S.error(loc.begin) << "array " << Var.Id << " must have a positive size.\n";
+
+  if (!Assign)
+    return;
+
+  Assign->check(S);
+
+  // Globals are initialized before the program runs.
+  auto Value = Assign->getValue();
+  if (auto Negative = dynamic_cast<ExprNegativeNode *>(Value))
+    Value = Negative->getRHS();
+  if (Var.Global && !dynamic_cast<LiteralNode *>(Value))
+    S.error(Value->loc.begin)
+        << "global " << Var.Id << " must be initialized with a literal.\n";
+}
+
+void VarDeclNodeListStmt::check(Sema &S) {
+  for (auto VarDecl : varDeclList)
+    VarDecl->check(S);
+}
+
+void ReturnNode::check(Sema &S) {
+  S.ReturnFound = true;
+
+  if (expr)
+    expr->check(S);
+
+  if (!S.ReturnTy) {
+    if (expr)
+      S.error(loc.begin) << "procedure " << S.FuncName
+                         << " cannot return a value\n";
+    return;
+  }
+
+  if (!expr) {
+    S.error(loc.begin) << "function " << S.FuncName
+                       << " must return a value of type '"
+                       << S.ReturnTy->str() << "'\n";
+    return;
+  }
+
+  if (expr->Ty && expr->Ty != S.ReturnTy)
+    S.error(expr->loc.begin) << "cannot return value of type '"
+                             << expr->Ty->str() << "', expected '"
+                             << S.ReturnTy->str() << "'\n";
+}
+
+void SkipNode::check(Sema &S) {
+  if (!S.LoopDepth)
+    S.error(loc.begin) << "skip command can appear only inside loops.\n";
+}
+
+void StopNode::check(Sema &S) {
+  if (!S.LoopDepth)
+    S.error(loc.begin) << "stop command can appear only inside loops.\n";
+}
+
+// @unroll and @vectorize take an optional count or vector width; @nounroll
+// and @novectorize turn the transformation off.
+void LoopNode::checkHints(Sema &S) {
+  for (auto &Hint : Hints) {
+    StringRef Name = Hint.Name.str();
+    bool Off = Name.consume_front("no");
+
+    HintState *State;
+    unsigned *Value;
+    if (Name == "unroll") {
+      State = &Unroll;
+      Value = &UnrollCount;
+    } else if (Name == "vectorize") {
+      State = &Vectorize;
+      Value = &VectorizeWidth;
+    } else {
+      S.error(Hint.loc.begin) << "unknown loop hint '@" << Hint.Name
+                              << "'.\n";
+      continue;
+    }
+
+    if (*State != HintState::Default) {
+      S.error(Hint.loc.begin) << "loop hint '@" << Hint.Name
+                              << "' conflicts with an earlier one.\n";
+      continue;
+    }
+
+    if (Hint.HasArg && Off) {
+      S.error(Hint.loc.begin) << "'@" << Hint.Name
+                              << "' takes no argument.\n";
+      continue;
+    }
+
+    if (Hint.HasArg && (Hint.Arg < 1 || (State == &Vectorize &&
+                                         !isPowerOf2_32(Hint.Arg)))) {
+      S.error(Hint.loc.begin)
+          << "invalid argument " << Hint.Arg << " to '@" << Hint.Name
+          << "', expected a positive "
+          << (State == &Vectorize ? "power of two" : "count") << ".\n";
+      continue;
+    }
+
+    *State = Off ? HintState::Disable : HintState::Enable;
+    *Value = Hint.HasArg ? Hint.Arg : 0;
+  }
+
+  // A single lane is no vectorization at all.
+  if (Vectorize == HintState::Enable && VectorizeWidth == 1)
+    Vectorize = HintState::Disable;
+}
+
+void ForNode::check(Sema &S) {
+  checkHints(S);
+  Start->check(S);
+  End->check(S);
+  S.expect(End, Type::boolTy());
+  Step->check(S);
+
+  auto StartVar = Start->getVariable();
+  unsigned Assignments = StartVar ? StartVar->Assignments : 0;
+
+  ++S.LoopDepth;
+  S.ST.enterScope();
+  Body->check(S);
+  S.ST.leaveScope();
+  --S.LoopDepth;
+
+  // A global may change in any call the body makes. Ranges are only tracked
+  // for int, and a compound start such as i += 0 leaves the first value
+  // unknown.
+  if (StartVar && !Start->getIndex() && !StartVar->Global &&
+      !dynamic_cast<CompoundAssignNode *>(Start) &&
+      StartVar->Ty->isIntTy() && StartVar->Assignments == Assignments)
+    Counter = StartVar;
+}
+
+void WhileNode::check(Sema &S) {
+  checkHints(S);
+  Condition->check(S);
+  S.expect(Condition, Type::boolTy());
+
+  ++S.LoopDepth;
+  S.ST.enterScope();
+  Block->check(S);
+  S.ST.leaveScope();
+  --S.LoopDepth;
+}
+
+void VariableExprNode::check(Sema &S) {
+  auto Sym = dyn_cast_or_null<VariableSymbol>(S.ST.get(Id));
+  if (!Sym) {
+    S.error(loc.begin) << "variable '" << Id << "' not declared.\n";
+    return;
+  }
+
+  Var = Sym->Var;
+  Ty = Var->Ty;
+}
+
+void IndexExprNode::check(Sema &S) {
+  Index->check(S);
+  SideEffects = Index->SideEffects;
+  S.expect(Index, Type::intTy());
+
+  auto Sym = dyn_cast_or_null<VariableSymbol>(S.ST.get(Id));
+  if (!Sym) {
+    S.error(loc.begin) << "variable '" << Id << "' not declared.\n";
+    return;
+  }
+
+  Var = Sym->Var;
+  if (!Var->Ty->isArrayTy()) {
+    S.error(loc.begin) << "'" << Id << "' of type '" << Var->Ty->str()
+                       << "' is not an array.\n";
+    return;
+  }
+
+  Ty = Var->Ty->getElementType();
+}
+
+grace::Type *AssignNode::getTargetType() const {
+  return Index ? Var->Ty->getElementType() : Var->Ty;
+}
+
+void AssignNode::check(Sema &S) {
+  if (Index) {
+    Index->check(S);
+    S.expect(Index, Type::intTy());
+  }
+  Assign->check(S);
+
+  auto Sym = dyn_cast_or_null<VariableSymbol>(S.ST.get(Id));
+  if (!Sym) {
+    S.error(loc.begin) << "variable '" << Id << "' not declared.\n";
+    return;
+  }
+
+  Var = Sym->Var;
+
+  if (Index && !Var->Ty->isArrayTy()) {
+    S.error(loc.begin) << "'" << Id << "' of type '" << Var->Ty->str()
+                       << "' is not an array.\n";
+    Var = nullptr;
+    return;
+  }
+
+  if (!Index && Var->Ty->isArrayTy()) {
+    S.error(loc.begin) << "cannot assign to array '" << Id
+                       << "', only to its elements.\n";
+    Var = nullptr;
+    return;
+  }
+
+  if (!Index)
+    ++Var->Assignments;
+
+  if (Assign->Ty && Assign->Ty != getTargetType())
+    S.error(Assign->loc.begin) << "cannot assign value of type '"
+                               << Assign->Ty->str() << "', expected '"
+                               << getTargetType()->str() << "'\n";
+}
+
+void CompoundAssignNode::check(Sema &S) {
+  AssignNode::check(S);
+
+  if (Var && Assign->Ty == getTargetType() && !Assign->Ty->isNumericTy())
+    S.error(loc.begin) << "invalid operands to compound assignment ('"
+                       << Assign->Ty->str() << "' " << to_string(Op) << "= '"
+                       << Assign->Ty->str() << "')\n";
+}
+
+void ExprNegativeNode::check(Sema &S) {
+  RHS->check(S);
+  SideEffects = RHS->SideEffects;
+  if (RHS->Ty && RHS->Ty->isNumericTy()) {
+    Ty = RHS->Ty;
+    return;
+  }
+  S.expect(RHS, Type::intTy());
+  Ty = Type::intTy();
+}
+
+void ConvertExprNode::check(Sema &S) {
+  RHS->check(S);
+  SideEffects = RHS->SideEffects;
+  Ty = ToTy;
+  if (RHS->Ty && (!RHS->Ty->isNumericTy() || !ToTy->isNumericTy()))
+    S.error(loc.begin) << "cannot convert '" << RHS->Ty->str() << "' to '"
+                       << ToTy->str() << "'\n";
+}
+
+void ExprNotNode::check(Sema &S) {
+  RHS->check(S);
+  SideEffects = RHS->SideEffects;
+  S.expect(RHS, Type::boolTy());
+  Ty = Type::boolTy();
+}
+
+void ExprOperationNode::check(Sema &S) {
+  LHS->check(S);
+  RHS->check(S);
+  SideEffects = LHS->SideEffects || RHS->SideEffects;
+  if (!LHS->Ty || !RHS->Ty)
+    return;
+
+  Type *OperandTy = nullptr;
+  Type *ResultTy = Type::boolTy();
+
+  // Arithmetic and ordering take two operands of the same numeric type;
+  // there are no implicit conversions.
+  Type *NumericTy = LHS->Ty->isNumericTy() ? LHS->Ty : nullptr;
+
+  switch (Op) {
+  case BinOp::PLUS:
+    // '+' also concatenates strings.
+    OperandTy = LHS->Ty->isStringTy() ? Type::strTy() : NumericTy;
+    ResultTy = OperandTy;
+    break;
+  case BinOp::MINUS:
+  case BinOp::TIMES:
+  case BinOp::DIV:
+    OperandTy = NumericTy;
+    ResultTy = OperandTy;
+    break;
+  case BinOp::MOD:
+    OperandTy = LHS->Ty->isIntegerTy() ? LHS->Ty : nullptr;
+    ResultTy = OperandTy;
+    break;
+  case BinOp::SHL:
+  case BinOp::LSHR:
+  case BinOp::ASHR:
+  case BinOp::BITAND:
+    OperandTy = Type::intTy();
+    ResultTy = Type::intTy();
+    break;
+  case BinOp::LT:
+  case BinOp::LTEQ:
+  case BinOp::GT:
+  case BinOp::GTEQ:
+    // Strings are ordered by their bytes.
+    OperandTy = LHS->Ty->isStringTy() ? Type::strTy() : NumericTy;
+    break;
+  case BinOp::EQ:
+  case BinOp::DIFF:
+    // Any two values of the same type compare, except arrays. Strings
+    // compare by their characters.
+    if (!LHS->Ty->isArrayTy())
+      OperandTy = LHS->Ty;
+    break;
+  case BinOp::AND:
+  case BinOp::OR:
+    OperandTy = Type::boolTy();
+    break;
+  }
+
+  if (!OperandTy || LHS->Ty != OperandTy || RHS->Ty != OperandTy) {
+    S.error(loc.begin) << "invalid operands to binary expression ('"
+                       << LHS->Ty->str() << "' " << to_string(Op) << " '"
+                       << RHS->Ty->str() << "')\n";
+    return;
+  }
+
+  Ty = ResultTy;
+}
+
+// Whether an argument of type Passed may be given for a parameter of type
+// Declared. A parameter declared a[] takes an array of any size.
+static bool isPassable(grace::Type *Declared, grace::Type *Passed) {
+  if (Declared == Passed)
+    return true;
+  return Declared->isArrayTy() && Passed->isArrayTy() &&
+         !Declared->getArraySize() &&
+         Declared->getElementType() == Passed->getElementType();
+}
+
+// The array an argument passes by reference, or null.
+static Variable *getPassedArray(ExprNode *Arg) {
+  auto V = dynamic_cast<VariableExprNode *>(Arg);
+  if (!V || !V->Ty->isArrayTy())
+    return nullptr;
+  return V->getVariable();
+}
+
+void CallExprNode::check(Sema &S) {
+  for (auto Arg : *Args)
+    Arg->check(S);
+  SideEffects = true;
+
+  auto Sym = dyn_cast_or_null<FuncSymbol>(S.ST.get(Callee));
+  if (!Sym) {
+    S.error(loc.begin) << "function '" << Callee << "' not found.\n";
+    return;
+  }
+
+  if (Sym->Args.size() != Args->size()) {
+    S.error(loc.begin) << "incorrect number of arguments passed to function "
+                       << Callee << "\n";
+    return;
+  }
+
+  bool ErrorFound = false;
+  for (unsigned i = 0; i < Args->size(); ++i) {
+    auto DeclaredTy = Sym->Args[i];
+    auto PassedTy = (*Args)[i]->Ty;
+
+    if (!PassedTy) {
+      ErrorFound = true;
+    } else if (!isPassable(DeclaredTy, PassedTy)) {
+      S.error((*Args)[i]->loc.begin)
+          << "wrong param type passed to function '" << Callee
+          << "' at index '" << std::to_string(i) << "', expected '"
+          << DeclaredTy->str() << "', but found '" << PassedTy->str()
+          << "'\n";
+      ErrorFound = true;
+    }
+  }
+
+  if (ErrorFound)
+    return;
+
+  // Array parameters are noalias, so no array may be passed twice.
+  for (unsigned i = 0; i < Args->size(); ++i) {
+    auto Array = getPassedArray((*Args)[i]);
+    for (unsigned j = 0; Array && j < i; ++j) {
+      if (getPassedArray((*Args)[j]) == Array) {
+        S.error((*Args)[i]->loc.begin)
+            << "array '" << Array->Id << "' is passed to function '"
+            << Callee << "' more than once.\n";
+        break;
+      }
+    }
+  }
+
+  Ty = Sym->ReturnTy;
+
+  if (Sym == S.Likely || Sym == S.Unlikely) {
+    Hint = Sym == S.Likely ? BranchHint::Likely : BranchHint::Unlikely;
+    SideEffects = (*Args)[0]->SideEffects;
+  } else if (Sym == S.Length) {
+    IsLength = true;
+    SideEffects = (*Args)[0]->SideEffects;
+  }
+}
+
+void ReadNode::check(Sema &S) {
+  for (auto Target : *Targets) {
+    Target->check(S);
+    // Elements of arrays do not count as assignments.
+    auto VarExpr = dynamic_cast<VariableExprNode *>(Target);
+    if (!Target->Ty || !VarExpr)
+      continue;
+
+    auto Var = VarExpr->getVariable();
+    if (Var->Ty->isArrayTy() && !Var->Ty->getArraySize())
+      S.error(Target->loc.begin) << "cannot read array '" << Var->Id
+                                 << "' of unknown size\n";
+    else if (!Var->Ty->isArrayTy())
+      ++Var->Assignments;
+  }
+}
+
+void WriteNode::check(Sema &S) {
+  for (auto Expr : *Exprs) {
+    Expr->check(S);
+    if (Expr->Ty && Expr->Ty->isArrayTy())
+      S.error(Expr->loc.begin) << "cannot write array of type '"
+                               << Expr->Ty->str() << "'\n";
+  }
+}
@@ -0,0 +1,507 @@
+#include "Simplify.hh"
+#include "Type.hh"
+#include "llvm/Support/MathExtras.h"
+#include <cstdint>
+
+using namespace llvm;
+using namespace grace;
+
+LiteralIntNode *Simplifier::makeInt(const yy::location &Loc, int Value) {
+  auto L = A.make<LiteralIntNode>(Loc, Value);
+  L->Ty = Type::intTy();
+  return L;
+}
+
+LiteralInt64Node *Simplifier::makeInt64(const yy::location &Loc,
+                                        int64_t Value) {
+  auto L = A.make<LiteralInt64Node>(Loc, Value);
+  L->Ty = Type::int64Ty();
+  return L;
+}
+
+LiteralFloatNode *Simplifier::makeFloat(const yy::location &Loc, double Value,
+                                        bool IsDouble) {
+  auto L = A.make<LiteralFloatNode>(Loc, Value, IsDouble);
+  L->Ty = IsDouble ? Type::doubleTy() : Type::floatTy();
+  return L;
+}
+
+LiteralBoolNode *Simplifier::makeBool(const yy::location &Loc, bool Value) {
+  auto L = A.make<LiteralBoolNode>(Loc, Value);
+  L->Ty = Type::boolTy();
+  return L;
+}
+
+ExprNode *Simplifier::makeOperation(const yy::location &Loc, ExprNode *LHS,
+                                    BinOp Op, ExprNode *RHS) {
+  auto E = A.make<ExprOperationNode>(Loc, LHS, Op, RHS);
+  E->Ty = Type::intTy();
+  E->SideEffects = LHS->SideEffects || RHS->SideEffects;
+  return E;
+}
+
+static LiteralIntNode *asInt(ExprNode *E) {
+  return dynamic_cast<LiteralIntNode *>(E);
+}
+
+static LiteralBoolNode *asBool(ExprNode *E) {
+  return dynamic_cast<LiteralBoolNode *>(E);
+}
+
+static LiteralInt64Node *asInt64(ExprNode *E) {
+  return dynamic_cast<LiteralInt64Node *>(E);
+}
+
+static LiteralFloatNode *asFloat(ExprNode *E) {
+  return dynamic_cast<LiteralFloatNode *>(E);
+}
+
+// The value of a float or double literal, rounded to its type.
+static double getFloatValue(LiteralFloatNode *L) {
+  return L->IsDouble ? L->FVal : double(float(L->FVal));
+}
+
+// Whether control never reaches the statement after Stmt.
+static bool isTerminator(StmtNode *Stmt) {
+  return dynamic_cast<ReturnNode *>(Stmt) || dynamic_cast<SkipNode *>(Stmt) ||
+         dynamic_cast<StopNode *>(Stmt);
+}
+
+void BlockNode::simplify(Simplifier &S) {
+  StmtList Out(Stmts.get_allocator());
+  Out.reserve(Stmts.size());
+
+  for (auto Stmt : Stmts) {
+    Stmt->simplify(S, Out);
+    if (!Out.empty() && isTerminator(Out.back()))
+      break;
+  }
+
+  Stmts.swap(Out);
+}
+
+ExprNode *LiteralIntNode::simplify(Simplifier &S) { return this; }
+
+ExprNode *LiteralStringNode::simplify(Simplifier &S) { return this; }
+
+ExprNode *LiteralBoolNode::simplify(Simplifier &S) { return this; }
+
+ExprNode *LiteralInt64Node::simplify(Simplifier &S) { return this; }
+
+ExprNode *LiteralFloatNode::simplify(Simplifier &S) { return this; }
+
+void IfThenElseNode::simplify(Simplifier &S, StmtList &Out) {
+  Condition = Condition->simplify(S);
+
+  // The variables of the branch keep their storage, so its statements can
+  // join the enclosing block.
+  if (auto L = asBool(Condition)) {
+    BlockNode *Taken = L->BVal ? Then : Else;
+    if (Taken) {
+      Taken->simplify(S);
+      Out.insert(Out.end(), Taken->Stmts.begin(), Taken->Stmts.end());
+    }
+    return;
+  }
+
+  Then->simplify(S);
+  if (Else)
+    Else->simplify(S);
+  Out.push_back(this);
+}
+
+void FuncDeclNode::simplify(Simplifier &S, StmtList &Out) {
+  Body->simplify(S);
+  Out.push_back(this);
+}
+
+void ProcDeclNode::simplify(Simplifier &S, StmtList &Out) {
+  Body->simplify(S);
+  Out.push_back(this);
+}
+
+bool VarDeclNode::simplifyDecl(Simplifier &S) {
+  if (!Assign)
+    return true;
+
+  Assign->simplifyValue(S);
+  if (Var.Assignments != 1)
+    return true;
+
+  // Strings are left alone: each use would get its own copy.
+  auto Value = Assign->getValue();
+  if (asInt(Value) || asBool(Value) || asInt64(Value) || asFloat(Value)) {
+    S.setConstant(&Var, static_cast<LiteralNode *>(Value));
+    return false;
+  }
+
+  return true;
+}
+
+void VarDeclNode::simplify(Simplifier &S, StmtList &Out) {
+  if (simplifyDecl(S))
+    Out.push_back(this);
+}
+
+void VarDeclNodeListStmt::simplify(Simplifier &S, StmtList &Out) {
+  VarDeclNodeList Kept(varDeclList.get_allocator());
+  for (auto VarDecl : varDeclList)
+    if (VarDecl->simplifyDecl(S))
+      Kept.push_back(VarDecl);
+
+  varDeclList.swap(Kept);
+  if (!varDeclList.empty())
+    Out.push_back(this);
+}
+
+void ReturnNode::simplify(Simplifier &S, StmtList &Out) {
+  if (expr)
+    expr = expr->simplify(S);
+  Out.push_back(this);
+}
+
+void SkipNode::simplify(Simplifier &S, StmtList &Out) { Out.push_back(this); }
+
+void StopNode::simplify(Simplifier &S, StmtList &Out) { Out.push_back(this); }
+
+void ForNode::simplify(Simplifier &S, StmtList &Out) {
+  Start->simplifyValue(S);
+  End = End->simplify(S);
+
+  // A loop that never runs leaves only its initialization behind.
+  auto L = asBool(End);
+  if (L && !L->BVal) {
+    Out.push_back(Start);
+    return;
+  }
+
+  Step->simplifyValue(S);
+  Body->simplify(S);
+  Out.push_back(this);
+}
+
+void WhileNode::simplify(Simplifier &S, StmtList &Out) {
+  Condition = Condition->simplify(S);
+
+  auto L = asBool(Condition);
+  if (L && !L->BVal)
+    return;
+
+  Block->simplify(S);
+  Out.push_back(this);
+}
+
+ExprNode *VariableExprNode::simplify(Simplifier &S) {
+  auto Value = S.getConstant(Var);
+  if (!Value)
+    return this;
+
+  // A fresh literal, so the use keeps its own location.
+  if (auto L = asInt(Value))
+    return S.makeInt(loc, L->IVal);
+  if (auto L = asInt64(Value))
+    return S.makeInt64(loc, L->IVal);
+  if (auto L = asFloat(Value))
+    return S.makeFloat(loc, L->FVal, L->IsDouble);
+  return S.makeBool(loc, asBool(Value)->BVal);
+}
+
+void AssignNode::simplifyValue(Simplifier &S) {
+  if (Index)
+    Index = Index->simplify(S);
+  Assign = Assign->simplify(S);
+}
+
+ExprNode *IndexExprNode::simplify(Simplifier &S) {
+  Index = Index->simplify(S);
+  return this;
+}
+
+void AssignNode::simplify(Simplifier &S, StmtList &Out) {
+  simplifyValue(S);
+  Out.push_back(this);
+}
+
+ExprNode *ExprNegativeNode::simplify(Simplifier &S) {
+  RHS = RHS->simplify(S);
+
+  auto L = asInt(RHS);
+  if (L && (L->IVal != INT32_MIN || S.getOverflow() != OverflowKind::Trap))
+    return S.makeInt(loc, int32_t(0u - uint32_t(L->IVal)));
+
+  auto L64 = asInt64(RHS);
+  if (L64 && (L64->IVal != INT64_MIN || S.getOverflow() != OverflowKind::Trap))
+    return S.makeInt64(loc, int64_t(0ull - uint64_t(L64->IVal)));
+
+  if (auto F = asFloat(RHS))
+    return S.makeFloat(loc, -F->FVal, F->IsDouble);
+
+  // --x is x, except that negating the minimum twice must trap.
+  auto Inner = dynamic_cast<ExprNegativeNode *>(RHS);
+  if (Inner && (Ty->isFloatingPointTy() ||
+                S.getOverflow() != OverflowKind::Trap))
+    return Inner->RHS;
+
+  return this;
+}
+
+// Conversions of constants are done here, except those of floating point
+// values out of range of the integer type, which are undefined.
+ExprNode *ConvertExprNode::simplify(Simplifier &S) {
+  RHS = RHS->simplify(S);
+  if (RHS->Ty == Ty)
+    return RHS;
+
+  int64_t IntValue;
+  if (auto L = asInt(RHS))
+    IntValue = L->IVal;
+  else if (auto L = asInt64(RHS))
+    IntValue = L->IVal;
+  else if (auto F = asFloat(RHS)) {
+    double Value = getFloatValue(F);
+    if (Ty->isFloatingPointTy())
+      return S.makeFloat(loc, Value, Ty->isDoubleTy());
+    // Conversion truncates toward zero, so everything strictly between
+    // -Limit - 1 and Limit is in range.
+    double Limit = Ty->isIntTy() ? 2147483648.0 : 9223372036854775808.0;
+    if (!(Value > -Limit - 1 && Value < Limit))
+      return this;
+    if (Ty->isIntTy())
+      return S.makeInt(loc, int32_t(Value));
+    return S.makeInt64(loc, int64_t(Value));
+  } else {
+    return this;
+  }
+
+  if (Ty->isIntTy())
+    return S.makeInt(loc, int32_t(uint32_t(IntValue)));
+  if (Ty->isInt64Ty())
+    return S.makeInt64(loc, IntValue);
+  if (Ty->isFloatTy())
+    return S.makeFloat(loc, double(float(IntValue)), false);
+  return S.makeFloat(loc, double(IntValue), true);
+}
+
+ExprNode *ExprNotNode::simplify(Simplifier &S) {
+  RHS = RHS->simplify(S);
+
+  if (auto L = asBool(RHS))
+    return S.makeBool(loc, !L->BVal);
+
+  if (auto Inner = dynamic_cast<ExprNotNode *>(RHS))
+    return Inner->RHS;
+
+  return this;
+}
+
+// Fold an operation on two integer constants. Overflowing arithmetic wraps
+// around, which every --overflow mode but trap allows. Division by zero and
+// INT_MIN / -1 are left for run time.
+static ExprNode *foldInts(Simplifier &S, const yy::location &Loc, BinOp Op,
+                          int LHS, int RHS) {
+  uint32_t L = LHS, R = RHS;
+  int64_t Wide = 0;
+
+  switch (Op) {
+  case BinOp::PLUS:
+    Wide = int64_t(LHS) + RHS;
+    break;
+  case BinOp::MINUS:
+    Wide = int64_t(LHS) - RHS;
+    break;
+  case BinOp::TIMES:
+    Wide = int64_t(LHS) * RHS;
+    break;
+  case BinOp::DIV:
+  case BinOp::MOD:
+    if (RHS == 0 || (LHS == INT32_MIN && RHS == -1))
+      return nullptr;
+    return S.makeInt(Loc, Op == BinOp::DIV ? LHS / RHS : LHS % RHS);
+  case BinOp::SHL:
+    return S.makeInt(Loc, int32_t(L << (R & 31)));
+  case BinOp::LSHR:
+    return S.makeInt(Loc, int32_t(L >> (R & 31)));
+  case BinOp::ASHR:
+    return S.makeInt(Loc, LHS >> (R & 31));
+  case BinOp::BITAND:
+    return S.makeInt(Loc, int32_t(L & R));
+  case BinOp::LT:
+    return S.makeBool(Loc, LHS < RHS);
+  case BinOp::LTEQ:
+    return S.makeBool(Loc, LHS <= RHS);
+  case BinOp::GT:
+    return S.makeBool(Loc, LHS > RHS);
+  case BinOp::GTEQ:
+    return S.makeBool(Loc, LHS >= RHS);
+  case BinOp::EQ:
+    return S.makeBool(Loc, LHS == RHS);
+  case BinOp::DIFF:
+    return S.makeBool(Loc, LHS != RHS);
+  case BinOp::AND:
+  case BinOp::OR:
+    return nullptr;
+  }
+
+  if (S.getOverflow() == OverflowKind::Trap &&
+      (Wide < INT32_MIN || Wide > INT32_MAX))
+    return nullptr;
+  return S.makeInt(Loc, int32_t(uint32_t(Wide)));
+}
+
+// Signed division by 2^K rounds toward zero, so a negative dividend is
+// biased by 2^K - 1 before shifting: X + ((X >> 31) >>> (32 - K)).
+static ExprNode *makeBiased(Simplifier &S, const yy::location &Loc,
+                            ExprNode *X, unsigned K) {
+  auto Sign = S.makeOperation(Loc, X, BinOp::ASHR, S.makeInt(Loc, 31));
+  auto Bias = S.makeOperation(Loc, Sign, BinOp::LSHR, S.makeInt(Loc, 32 - K));
+  return S.makeOperation(Loc, X, BinOp::PLUS, Bias);
+}
+
+static ExprNode *foldBools(Simplifier &S, const yy::location &Loc, BinOp Op,
+                           bool LHS, bool RHS) {
+  switch (Op) {
+  case BinOp::AND:
+    return S.makeBool(Loc, LHS && RHS);
+  case BinOp::OR:
+    return S.makeBool(Loc, LHS || RHS);
+  case BinOp::EQ:
+    return S.makeBool(Loc, LHS == RHS);
+  case BinOp::DIFF:
+    return S.makeBool(Loc, LHS != RHS);
+  default:
+    return nullptr;
+  }
+}
+
+ExprNode *ExprOperationNode::simplify(Simplifier &S) {
+  LHS = LHS->simplify(S);
+  RHS = RHS->simplify(S);
+
+  auto LInt = asInt(LHS), RInt = asInt(RHS);
+  if (LInt && RInt)
+    if (auto Folded = foldInts(S, loc, Op, LInt->IVal, RInt->IVal))
+      return Folded;
+
+  auto LBool = asBool(LHS), RBool = asBool(RHS);
+  if (LBool && RBool)
+    return foldBools(S, loc, Op, LBool->BVal, RBool->BVal);
+
+  // Identities with one constant operand. An operand that would have been
+  // evaluated is only dropped when evaluating it has no side effects.
+  switch (Op) {
+  case BinOp::PLUS:
+    if (RInt && RInt->IVal == 0)
+      return LHS;
+    if (LInt && LInt->IVal == 0)
+      return RHS;
+    break;
+
+  case BinOp::MINUS:
+    if (RInt && RInt->IVal == 0)
+      return LHS;
+    break;
+
+  case BinOp::TIMES: {
+    // Multiplication commutes, so look at the constant on the right.
+    if (LInt)
+      std::swap(LHS, RHS), std::swap(LInt, RInt);
+    if (!RInt)
+      break;
+
+    int R = RInt->IVal;
+    if (R == 0 && !LHS->SideEffects)
+      return RHS;
+    if (R == 1)
+      return LHS;
+    // Shifting hides the overflow that --overflow=trap must catch.
+    if (R > 0 && isPowerOf2_32(R) && S.getOverflow() != OverflowKind::Trap)
+      return S.makeOperation(loc, LHS, BinOp::SHL,
+                             S.makeInt(RInt->loc, Log2_32(R)));
+    break;
+  }
+
+  // The shift sequences below read the dividend more than once, so they are
+  // only used on variables. Their additions never overflow, but under
+  // --overflow=trap they would still be checked, so LLVM is left to lower
+  // the division by a constant itself.
+  case BinOp::DIV:
+    if (RInt && RInt->IVal == 1)
+      return LHS;
+    if (RInt && RInt->IVal > 1 && isPowerOf2_32(RInt->IVal) &&
+        dynamic_cast<VariableExprNode *>(LHS) &&
+        S.getOverflow() != OverflowKind::Trap) {
+      unsigned K = Log2_32(RInt->IVal);
+      return S.makeOperation(loc, makeBiased(S, loc, LHS, K), BinOp::ASHR,
+                             S.makeInt(RInt->loc, K));
+    }
+    break;
+
+  case BinOp::MOD:
+    // INT_MIN % -1 overflows, which --overflow=trap must catch.
+    if (RInt && !LHS->SideEffects &&
+        (RInt->IVal == 1 ||
+         (RInt->IVal == -1 && S.getOverflow() != OverflowKind::Trap)))
+      return S.makeInt(loc, 0);
+    // X - ((X + bias) & -2^K)
+    if (RInt && RInt->IVal > 1 && isPowerOf2_32(RInt->IVal) &&
+        dynamic_cast<VariableExprNode *>(LHS) &&
+        S.getOverflow() != OverflowKind::Trap) {
+      unsigned K = Log2_32(RInt->IVal);
+      auto Rounded = S.makeOperation(loc, makeBiased(S, loc, LHS, K),
+                                     BinOp::BITAND,
+                                     S.makeInt(RInt->loc, -RInt->IVal));
+      return S.makeOperation(loc, LHS, BinOp::MINUS, Rounded);
+    }
+    break;
+
+  // The right operand of && and || only runs when the left one does not
+  // decide the result.
+  case BinOp::AND:
+    if (LBool)
+      return LBool->BVal ? RHS : LHS;
+    if (RBool)
+      return RBool->BVal ? LHS : (LHS->SideEffects ? this : RHS);
+    break;
+
+  case BinOp::OR:
+    if (LBool)
+      return LBool->BVal ? LHS : RHS;
+    if (RBool)
+      return RBool->BVal ? (LHS->SideEffects ? this : RHS) : LHS;
+    break;
+
+  default:
+    break;
+  }
+
+  return this;
+}
+
+ExprNode *CallExprNode::simplify(Simplifier &S) {
+  for (auto &Arg : *Args)
+    Arg = Arg->simplify(S);
+
+  // A hint about a constant has nothing left to say.
+  if (Hint != BranchHint::None && asBool((*Args)[0]))
+    return (*Args)[0];
+
+  if (IsLength)
+    if (auto Str = dynamic_cast<LiteralStringNode *>((*Args)[0]))
+      return S.makeInt(loc, Str->Str.size());
+
+  return this;
+}
+
+void ReadNode::simplify(Simplifier &S, StmtList &Out) {
+  // A variable read into must stay a variable, only indices simplify.
+  for (auto Target : *Targets)
+    if (auto Element = dynamic_cast<IndexExprNode *>(Target))
+      Element->simplify(S);
+  Out.push_back(this);
+}
+
+void WriteNode::simplify(Simplifier &S, StmtList &Out) {
+  for (auto &Expr : *Exprs)
+    Expr = Expr->simplify(S);
+  Out.push_back(this);
+}
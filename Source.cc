@@ -0,0 +1,98 @@
+#include "Source.hh"
+#include "Log.hh"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace grace;
+
+SourceBuffer::~SourceBuffer() {
+  if (MappedLength)
+    munmap(Data, MappedLength);
+  else
+    delete[] Data;
+}
+
+// Read everything left in FD, for pipes and other files that cannot be
+// mapped.
+static bool readAll(int FD, std::string &Text) {
+  char Chunk[64 * 1024];
+  for (;;) {
+    ssize_t N = read(FD, Chunk, sizeof(Chunk));
+    if (N == 0)
+      return true;
+    if (N < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    Text.append(Chunk, N);
+  }
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromFile(const std::string &Path) {
+  bool IsStdin = Path.empty() || Path == "-";
+  int FD = IsStdin ? STDIN_FILENO : open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  auto Fail = [&] {
+    Log::message() << "cannot open " << (IsStdin ? "<stdin>" : Path) << ": "
+                   << strerror(errno) << "\n";
+    if (FD >= 0 && !IsStdin)
+      close(FD);
+    return nullptr;
+  };
+
+  if (FD < 0)
+    return Fail();
+
+  struct stat Status;
+  if (fstat(FD, &Status) != 0)
+    return Fail();
+
+  if (!S_ISREG(Status.st_mode)) {
+    std::string Text;
+    if (!readAll(FD, Text))
+      return Fail();
+    if (!IsStdin)
+      close(FD);
+    return fromString(Text);
+  }
+
+  std::unique_ptr<SourceBuffer> Buffer(new SourceBuffer());
+  Buffer->Size = Status.st_size;
+  Buffer->MappedLength = Buffer->Size + 2;
+
+  // Reserve room for the text and the terminators with zeroed anonymous
+  // memory, then map the file over its start. Bytes past the end of the file
+  // read as zero whether they fall in the file's last page or in the
+  // anonymous tail, so the terminators come for free.
+  void *Region = mmap(nullptr, Buffer->MappedLength, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (Region == MAP_FAILED)
+    return Fail();
+  Buffer->Data = static_cast<char *>(Region);
+
+  if (Buffer->Size &&
+      mmap(Region, Buffer->Size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_FIXED, FD, 0) == MAP_FAILED)
+    return Fail();
+
+  // The scanner walks the file front to back exactly once.
+  madvise(Region, Buffer->MappedLength, MADV_SEQUENTIAL);
+
+  if (!IsStdin)
+    close(FD);
+  return Buffer;
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromString(llvm::StringRef Text) {
+  std::unique_ptr<SourceBuffer> Buffer(new SourceBuffer());
+  Buffer->Size = Text.size();
+  Buffer->Data = new char[Text.size() + 2];
+  memcpy(Buffer->Data, Text.data(), Text.size());
+  Buffer->Data[Text.size()] = Buffer->Data[Text.size() + 1] = '\0';
+  return Buffer;
+}
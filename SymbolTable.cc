@@ -1,3 +1,72 @@
 //
 // Created by Guilherme Souza on 12/7/18.
 //
+
+#include "SymbolTable.hh"
+
+using namespace grace;
+
+SymbolTable::~SymbolTable() {
+  while (!Scopes.empty())
+    leaveScope();
+}
+
+void *SymbolTable::allocate(size_t Size, size_t Alignment) {
+  assert(Size <= SlabSize && "symbol larger than a slab");
+
+  size_t Offset = (CurOffset + Alignment - 1) & ~(Alignment - 1);
+  if (Slabs.empty() || Offset + Size > SlabSize) {
+    // Move on to the next slab, reusing one left over from a previous scope.
+    if (!Slabs.empty())
+      ++CurSlab;
+    if (CurSlab == Slabs.size())
+      Slabs.emplace_back(new char[SlabSize]);
+    Offset = 0;
+  }
+
+  CurOffset = Offset + Size;
+  return Slabs[CurSlab].get() + Offset;
+}
+
+void SymbolTable::bind(Identifier Id, Symbol *Sym) {
+  assert(!Scopes.empty() && "no scope to define a symbol in");
+
+  if (Id.getId() >= Bindings.size())
+    Bindings.resize(Names.size(), nullptr);
+
+  Undo.push_back({Id.getId(), Bindings[Id.getId()]});
+  Bindings[Id.getId()] = Sym;
+}
+
+void SymbolTable::destroy(Symbol *Sym) {
+  switch (Sym->getKind()) {
+  case SymbolKind::Variable:
+    static_cast<VariableSymbol *>(Sym)->~VariableSymbol();
+    break;
+  case SymbolKind::Block:
+    static_cast<BlockSymbol *>(Sym)->~BlockSymbol();
+    break;
+  case SymbolKind::Func:
+    static_cast<FuncSymbol *>(Sym)->~FuncSymbol();
+    break;
+  }
+}
+
+void SymbolTable::enterScope() {
+  Scopes.push_back({Undo.size(), CurSlab, CurOffset});
+}
+
+void SymbolTable::leaveScope() {
+  const Mark &Scope = Scopes.back();
+
+  while (Undo.size() > Scope.UndoSize) {
+    const Shadowed &Entry = Undo.back();
+    destroy(Bindings[Entry.Id]);
+    Bindings[Entry.Id] = Entry.Previous;
+    Undo.pop_back();
+  }
+
+  CurSlab = Scope.Slab;
+  CurOffset = Scope.Offset;
+  Scopes.pop_back();
+}
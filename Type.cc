@@ -2,63 +2,88 @@
 // Created by Guilherme Souza on 12/7/18.
 //
 
+#include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Type.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "Context.hh"
 #include <Type.hh>
 
 using namespace grace;
 
-llvm::Type *IntType::emit(Context &C) {
-  return llvm::Type::getInt32Ty(C.getContext());
+TypeContext &TypeContext::get() {
+  static TypeContext TheTypeContext;
+  return TheTypeContext;
 }
 
-llvm::Type *BoolType::emit(Context &C) {
-  return llvm::Type::getInt1Ty(C.getContext());
+grace::Type *TypeContext::getArrayTy(Type *Element, unsigned Size) {
+  std::lock_guard<std::mutex> Lock(ArraysLock);
+  auto &Slot = Arrays[{Element, Size}];
+  if (!Slot)
+    Slot.reset(new Type(Element, Size));
+  return Slot.get();
 }
 
-llvm::Type *StringType::emit(Context &C) {
-  llvm::errs() << "unimplemented\n";
-  return nullptr;
+llvm::Type *grace::Type::emit(Context &C) const {
+  switch (Kind) {
+  case TypeKind::Int:
+    return llvm::Type::getIntNTy(C.getContext(), INT_SIZE);
+  case TypeKind::Int64:
+    return llvm::Type::getIntNTy(C.getContext(), INT64_SIZE);
+  case TypeKind::Float:
+    return llvm::Type::getFloatTy(C.getContext());
+  case TypeKind::Double:
+    return llvm::Type::getDoubleTy(C.getContext());
+  case TypeKind::Bool:
+    return llvm::Type::getIntNTy(C.getContext(), BOOL_SIZE);
+  case TypeKind::String:
+    return C.getStringTy();
+  case TypeKind::Array:
+    assert(Size && "an array parameter has no value type");
+    return llvm::ArrayType::get(Element->emit(C), Size);
+  }
+  llvm_unreachable("unknown type kind");
 }
 
-grace::Type *grace::Type::from(llvm::Type *Ty) {
-  if (Ty->isIntegerTy(32))
-    return intTy();
-
-  if (Ty->isIntegerTy(1))
-    return boolTy();
-
-  return nullptr;
+llvm::Type *grace::Type::emitParam(Context &C) const {
+  if (Kind == TypeKind::Array)
+    return Element->emit(C)->getPointerTo();
+  return emit(C);
 }
 
-bool grace::Type::isIntTy() const {
-  return dynamic_cast<const IntType *>(this) != nullptr;
+std::string grace::Type::str() const {
+  switch (Kind) {
+  case TypeKind::Int:
+    return "int";
+  case TypeKind::Int64:
+    return "int64";
+  case TypeKind::Float:
+    return "float";
+  case TypeKind::Double:
+    return "double";
+  case TypeKind::Bool:
+    return "bool";
+  case TypeKind::String:
+    return "string";
+  case TypeKind::Array:
+    return Element->str() + "[" + (Size ? std::to_string(Size) : "") + "]";
+  }
+  llvm_unreachable("unknown type kind");
 }
 
-bool grace::Type::isStringTy() const {
-  return dynamic_cast<const StringType *>(this) != nullptr;
-}
+grace::Type *grace::Type::boolTy() { return TypeContext::get().getBoolTy(); }
 
-bool grace::Type::isBoolTy() const {
-  return dynamic_cast<const BoolType *>(this) != nullptr;
-}
+grace::Type *grace::Type::intTy() { return TypeContext::get().getIntTy(); }
 
-bool grace::Type::operator==(const grace::Type &Other) {
-  if (isIntTy() && Other.isIntTy())
-    return true;
-  if (isBoolTy() && Other.isBoolTy())
-    return true;
-  if (isStringTy() && Other.isStringTy())
-    return true;
-  return false;
-}
+grace::Type *grace::Type::int64Ty() { return TypeContext::get().getInt64Ty(); }
 
-bool grace::Type::operator!=(const grace::Type &Other) {
-  return !(*this == Other);
-}
+grace::Type *grace::Type::floatTy() { return TypeContext::get().getFloatTy(); }
 
-grace::Type *grace::Type::boolTy() { return new BoolType(); }
+grace::Type *grace::Type::doubleTy() {
+  return TypeContext::get().getDoubleTy();
+}
 
-grace::Type *grace::Type::intTy() { return new IntType(); }
+grace::Type *grace::Type::strTy() { return TypeContext::get().getStrTy(); }
 
-grace::Type *grace::Type::strTy() { return new StringType(); }
+grace::Type *grace::Type::arrayTy(Type *Element, unsigned Size) {
+  return TypeContext::get().getArrayTy(Element, Size);
+}
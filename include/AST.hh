@@ -1,7 +1,10 @@
 
 #pragma once
 
+#include "Arena.hh"
 #include "BinOp.hh"
+#include "StringPool.hh"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Value.h"
 #include <fstream>
 #include <string>
@@ -9,9 +12,15 @@
 #include <vector>
 #include <location.hh>
 
+namespace llvm {
+class BasicBlock;
+};
+
 namespace grace {
 
 class Context;
+class Sema;
+class Simplifier;
 
 class Type;
 
@@ -48,6 +57,14 @@ static std::string to_string(const BinOp &Op) {
     return "&&";
   case BinOp::OR:
     return "||";
+  case BinOp::SHL:
+    return "<<";
+  case BinOp::LSHR:
+    return ">>>";
+  case BinOp::ASHR:
+    return ">>";
+  case BinOp::BITAND:
+    return "&";
   }
 }
 
@@ -57,22 +74,48 @@ class SpecVar;
 class LiteralNode;
 class ExprNode;
 
-typedef std::vector<StmtNode *> StmtList;
-typedef std::vector<VarDeclNode *> VarDeclNodeList;
-typedef std::vector<SpecVar *> SpecVarList;
+// Lists of AST nodes keep their elements in the Driver's arena too.
+typedef std::vector<StmtNode *, ArenaAllocator<StmtNode *>> StmtList;
+typedef std::vector<VarDeclNode *, ArenaAllocator<VarDeclNode *>>
+    VarDeclNodeList;
+typedef std::vector<SpecVar *, ArenaAllocator<SpecVar *>> SpecVarList;
 
-class Param {
+// A declared variable or parameter. Sema links every use of the name to its
+// Variable, and codegen records where the value is kept.
+class Variable {
 public:
-    yy::location loc;
-  std::string Id;
+  yy::location loc;
+  Identifier Id;
   Type *Ty;
 
-  Param(const yy::location &loc, std::string Id, Type *Ty) : loc(loc), Id(std::move(Id)), Ty(Ty) {}
+  // The variable's stack slot, or its global. Stays null for locals under
+  // --direct-ssa, where codegen tracks the variable's value in each block
+  // instead. An array's Storage points to its first element, which for a
+  // parameter is the pointer passed in.
+  llvm::Value *Storage = nullptr;
+
+  // How many times the variable is assigned, its initializer included.
+  // Assignments to elements of an array do not count. Counted by Sema.
+  unsigned Assignments = 0;
+
+  // Declared at the top level. Set by Sema.
+  bool Global = false;
+
+  Variable(const yy::location &loc, Identifier Id, Type *Ty)
+      : loc(loc), Id(Id), Ty(Ty) {}
 };
 
-typedef std::vector<Param *> ParamList;
-typedef std::vector<ExprNode *> ExprList;
+class Param : public Variable {
+public:
+  using Variable::Variable;
+};
+
+typedef std::vector<Param *, ArenaAllocator<Param *>> ParamList;
+typedef std::vector<ExprNode *, ArenaAllocator<ExprNode *>> ExprList;
 
+// Every node is allocated in the arena of the Driver that parsed it and
+// lives until that arena is released. The hierarchy is plain single
+// inheritance, so a node is its vtable pointer, its location and its fields.
 class Node {
 public:
     yy::location loc;
@@ -83,31 +126,53 @@ public:
 
   virtual void dumpAST(std::ostream &os, unsigned level) const = 0;
 
+  // Resolve names and check types. Runs before codegen, which only ever
+  // sees trees that Sema accepted.
+  virtual void check(Sema &S) = 0;
+
   virtual llvm::Value *codegen(Context &C) = 0;
 };
 
-class StmtNode : virtual public Node {
+class StmtNode : public Node {
 public:
-//    StmtNode(const yy::location &loc) : Node(loc) {}
+  StmtNode(const yy::location &loc) : Node(loc) {}
+
+  // Simplify the statement and append what replaces it to Out: itself,
+  // nothing if it is dead, or the statements of a branch that is always
+  // taken.
+  virtual void simplify(Simplifier &S, StmtList &Out) = 0;
 };
 
-class ExprNode : virtual public Node {
+class ExprNode : public Node {
 public:
-//    ExprNode(const yy::location &loc) : Node(loc) {}
+  // The type of the expression, set by Sema. Null if it is ill-typed.
+  Type *Ty = nullptr;
+
+  // Whether evaluating the expression may call a function, set by Sema.
+  bool SideEffects = false;
+
+  ExprNode(const yy::location &loc) : Node(loc) {}
+
+  // Return the simplified expression, which may be this one.
+  virtual ExprNode *simplify(Simplifier &S) = 0;
+
+  // Branch to True or False depending on the value of this boolean
+  // expression. && and || branch on each operand in turn instead of
+  // computing a value.
+  virtual void codegenCond(Context &C, llvm::BasicBlock *True,
+                           llvm::BasicBlock *False);
 };
 
-class LiteralNode : virtual public ExprNode {
+class LiteralNode : public ExprNode {
 public:
-//    LiteralNode(const yy::location &loc) : Node(loc) {}
+  LiteralNode(const yy::location &loc) : ExprNode(loc) {}
 };
 
 class BlockNode : public Node {
 public:
   StmtList Stmts;
 
-    BlockNode(const yy::location &loc) : Node(loc) {
-
-    }
+  BlockNode(const yy::location &loc, Arena &A) : Node(loc), Stmts(A) {}
 
     void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(Body" << std::endl;
@@ -117,26 +182,52 @@ public:
     os << NestedLevel(level) << ")" << std::endl;
   }
 
+  void simplify(Simplifier &S);
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
+// An assignment to a variable, or with an Index to an element of an array.
 class AssignNode : public StmtNode {
 protected:
-  std::string Id;
+  Identifier Id;
+  ExprNode *Index = nullptr;
   ExprNode *Assign;
+  Variable *Var = nullptr;
+
+  // The type of what is assigned: the variable's, or its elements'.
+  Type *getTargetType() const;
+
+  // The address of the element, checked against the array's bounds.
+  llvm::Value *codegenElementPtr(Context &C);
 
 public:
 
-  AssignNode(const yy::location &loc, std::string Id, ExprNode *Assign)
-      : Node(loc), Id(std::move(Id)), Assign(Assign) {}
+  AssignNode(const yy::location &loc, Identifier Id, ExprNode *Assign)
+      : StmtNode(loc), Id(Id), Assign(Assign) {}
+  AssignNode(const yy::location &loc, Identifier Id, ExprNode *Index,
+             ExprNode *Assign)
+      : StmtNode(loc), Id(Id), Index(Index), Assign(Assign) {}
+
+  Variable *getVariable() const { return Var; }
+  ExprNode *getIndex() const { return Index; }
+  ExprNode *getValue() const { return Assign; }
+  void simplifyValue(Simplifier &S);
 
   void dumpAST(std::ostream &os, unsigned level) const override {
-    os << NestedLevel(level) << "(Assign id: " << Id
-       << "; value: " << std::endl;
+    os << NestedLevel(level) << "(Assign id: " << Id;
+    if (Index) {
+      os << "; index: " << std::endl;
+      Index->dumpAST(os, level + 1);
+      os << std::endl << NestedLevel(level);
+    }
+    os << "; value: " << std::endl;
     Assign->dumpAST(os, level + 1);
     os << std::endl << NestedLevel(level) << ")" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -144,8 +235,11 @@ class CompoundAssignNode : public AssignNode {
 public:
   BinOp Op;
 
-  CompoundAssignNode(const yy::location &loc, std::string id, BinOp Op, ExprNode *Assign)
-      : Node(loc), AssignNode(loc, id, Assign), Op(Op) {}
+  CompoundAssignNode(const yy::location &loc, Identifier id, BinOp Op, ExprNode *Assign)
+      : AssignNode(loc, id, Assign), Op(Op) {}
+  CompoundAssignNode(const yy::location &loc, Identifier id, ExprNode *Index,
+                     BinOp Op, ExprNode *Assign)
+      : AssignNode(loc, id, Index, Assign), Op(Op) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(assing id: " << Id
@@ -154,6 +248,7 @@ public:
     Assign->dumpAST(os, level + 1);
   }
 
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -161,25 +256,67 @@ class LiteralIntNode : public LiteralNode {
 public:
   int IVal;
 
-  LiteralIntNode(const yy::location &loc, int value) : Node(loc), IVal(value) {}
+  LiteralIntNode(const yy::location &loc, int value) : LiteralNode(loc), IVal(value) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(literal value: " << IVal << ")";
   }
 
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
 class LiteralStringNode : public LiteralNode {
 public:
-  std::string Str;
+  // The characters of the literal, escapes resolved, stored in the Driver's
+  // StringPool.
+  llvm::StringRef Str;
 
-  LiteralStringNode(const yy::location &loc, const std::string &Str) : Node(loc), Str(Str) {}
+  LiteralStringNode(const yy::location &loc, llvm::StringRef Str) : LiteralNode(loc), Str(Str) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
-    os << NestedLevel(level) << "(literal value: " << Str << ")";
+    os << NestedLevel(level) << "(literal value: \"" << Str.str() << "\")";
   }
 
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
+  llvm::Value *codegen(Context &C) override;
+};
+
+class LiteralInt64Node : public LiteralNode {
+public:
+  int64_t IVal;
+
+  LiteralInt64Node(const yy::location &loc, int64_t IVal)
+      : LiteralNode(loc), IVal(IVal) {}
+
+  void dumpAST(std::ostream &os, unsigned level) const override {
+    os << NestedLevel(level) << "(literal value: " << IVal << "L)";
+  }
+
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
+  llvm::Value *codegen(Context &C) override;
+};
+
+// A float literal, written with an f suffix, or a double literal. FVal is
+// the value as written, rounded to double.
+class LiteralFloatNode : public LiteralNode {
+public:
+  double FVal;
+  bool IsDouble;
+
+  LiteralFloatNode(const yy::location &loc, double FVal, bool IsDouble)
+      : LiteralNode(loc), FVal(FVal), IsDouble(IsDouble) {}
+
+  void dumpAST(std::ostream &os, unsigned level) const override {
+    os << NestedLevel(level) << "(literal value: " << FVal
+       << (IsDouble ? "" : "f") << ")";
+  }
+
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -187,38 +324,50 @@ class LiteralBoolNode : public LiteralNode {
 public:
   bool BVal;
 
-  LiteralBoolNode(const yy::location &loc, bool BVal) : Node(loc), BVal(BVal) {}
+  LiteralBoolNode(const yy::location &loc, bool BVal) : LiteralNode(loc), BVal(BVal) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(literal value: " << std::boolalpha << BVal
        << ")";
   }
 
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
 class SpecVar {
 public:
     yy::location loc;
-    std::string Id;
+    Identifier Id;
   AssignNode *Assign;
 
-  SpecVar(const yy::location &loc, std::string Id, AssignNode *Assign)
-      : loc(loc), Id(std::move(Id)), Assign(Assign) {}
+  // Declared as Id[Size].
+  bool IsArray = false;
+  unsigned Size = 0;
+
+  SpecVar(const yy::location &loc, Identifier Id, AssignNode *Assign)
+      : loc(loc), Id(Id), Assign(Assign) {}
+  SpecVar(const yy::location &loc, Identifier Id, unsigned Size)
+      : loc(loc), Id(Id), Assign(nullptr), IsArray(true), Size(Size) {}
 };
 
 class VarDeclNode : public StmtNode {
 protected:
-  std::string Id;
+  Variable Var;
   AssignNode *Assign;
-  Type *Ty;
 
 public:
-  VarDeclNode(const yy::location &loc, std::string Id, AssignNode *Assign, Type *Ty)
-      : Node(loc), Id(std::move(Id)), Assign(Assign), Ty(Ty) {}
+  VarDeclNode(const yy::location &loc, Identifier Id, AssignNode *Assign, Type *Ty)
+      : StmtNode(loc), Var(loc, Id, Ty), Assign(Assign) {}
+
+  // Simplify the initializer, and report whether the declaration is still
+  // needed: a variable whose only assignment is a constant initializer is
+  // replaced by the constant everywhere.
+  bool simplifyDecl(Simplifier &S);
 
   void dumpAST(std::ostream &os, unsigned level) const override {
-    os << NestedLevel(level) << "(varDecl id: " << Id << "; type: " << Ty;
+    os << NestedLevel(level) << "(varDecl id: " << Var.Id << "; type: " << Var.Ty;
 
     if (Assign) {
       os << std::endl;
@@ -229,6 +378,8 @@ public:
     os << ")" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -236,47 +387,61 @@ class VarDeclNodeListStmt : public StmtNode {
 public:
   VarDeclNodeList varDeclList;
 
-    VarDeclNodeListStmt(const yy::location &loc) : Node(loc) {
-
-    }
+  VarDeclNodeListStmt(const yy::location &loc, Arena &A)
+      : StmtNode(loc), varDeclList(A) {}
 
     void dumpAST(std::ostream &os, unsigned level) const override {
     for (const auto &varDecl : varDeclList)
       varDecl->dumpAST(os, level);
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
 class FuncDeclNode : public StmtNode {
-  std::string Name;
+  Identifier Name;
   Type *ReturnTy;
   ParamList *Args;
   BlockNode *Body;
+  bool Exported = false;
 
 public:
-  FuncDeclNode(const yy::location &loc, std::string Name, Type *ReturnTy, ParamList *Args,
+  FuncDeclNode(const yy::location &loc, Identifier Name, Type *ReturnTy, ParamList *Args,
                BlockNode *Body)
-      : Node(loc), Name(std::move(Name)), ReturnTy(ReturnTy), Args(Args), Body(Body) {}
+      : StmtNode(loc), Name(Name), ReturnTy(ReturnTy), Args(Args), Body(Body) {}
+
+  Identifier getName() const { return Name; }
+  Type *getReturnTy() const { return ReturnTy; }
+  const ParamList &getArgs() const { return *Args; }
+
+  // Declared with 'export'. Only main and exported functions can be called
+  // from other units; every other function is internal to its unit.
+  void setExported() { Exported = true; }
+  bool isExported() const { return Exported || Name.str() == "main"; }
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(function Name: " << Name
-       << "; ReturnType: " << ReturnTy << std::endl;
+       << "; ReturnType: " << ReturnTy << (Exported ? "; exported" : "")
+       << std::endl;
     Body->dumpAST(os, level + 1);
     os << NestedLevel(level) << ")" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
 class ProcDeclNode : public StmtNode {
-  std::string Name;
+  Identifier Name;
   ParamList *Args;
   BlockNode *Body;
 
 public:
-  ProcDeclNode(const yy::location &loc, std::string Name, ParamList *Args, BlockNode *Body)
-      : Node(loc), Name(std::move(Name)), Args(Args), Body(Body) {}
+  ProcDeclNode(const yy::location &loc, Identifier Name, ParamList *Args, BlockNode *Body)
+      : StmtNode(loc), Name(Name), Args(Args), Body(Body) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(function Name: " << Name << "; ReturnType: "
@@ -285,6 +450,8 @@ public:
     os << NestedLevel(level) << ")" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -294,7 +461,7 @@ class IfThenElseNode : public StmtNode {
 
 public:
   IfThenElseNode(const yy::location &loc, ExprNode *Condition, BlockNode *Then, BlockNode *Else)
-      : Node(loc), Condition(Condition), Then(Then), Else(Else) {}
+      : StmtNode(loc), Condition(Condition), Then(Then), Else(Else) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(if" << std::endl;
@@ -306,20 +473,51 @@ public:
     os << NestedLevel(level) << ")" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
 class VariableExprNode : public ExprNode {
 protected:
-  std::string Id;
+  Identifier Id;
+  Variable *Var = nullptr;
 
 public:
-    VariableExprNode(const yy::location &loc, std::string Id) : Node(loc), Id(std::move(Id)) {}
+    VariableExprNode(const yy::location &loc, Identifier Id) : ExprNode(loc), Id(Id) {}
+
+  Variable *getVariable() const { return Var; }
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(var " << Id << " )" << std::endl;
   }
 
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
+  llvm::Value *codegen(Context &C) override;
+};
+
+// An element of an array, Id[Index].
+class IndexExprNode : public ExprNode {
+  Identifier Id;
+  ExprNode *Index;
+  Variable *Var = nullptr;
+
+public:
+  IndexExprNode(const yy::location &loc, Identifier Id, ExprNode *Index)
+      : ExprNode(loc), Id(Id), Index(Index) {}
+
+  Variable *getVariable() const { return Var; }
+  ExprNode *getIndex() const { return Index; }
+
+  void dumpAST(std::ostream &os, unsigned level) const override {
+    os << NestedLevel(level) << "(index " << Id << std::endl;
+    Index->dumpAST(os, level + 1);
+    os << std::endl << NestedLevel(level) << ")";
+  }
+
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -327,7 +525,9 @@ class ExprNegativeNode : public ExprNode {
   ExprNode *RHS;
 
 public:
-   ExprNegativeNode(const yy::location &loc, ExprNode *RHS) : Node(loc), RHS(RHS) {}
+   ExprNegativeNode(const yy::location &loc, ExprNode *RHS) : ExprNode(loc), RHS(RHS) {}
+
+  ExprNode *getRHS() const { return RHS; }
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(-" << std::endl;
@@ -335,6 +535,28 @@ public:
     os << ")" << std::endl;
   }
 
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
+  llvm::Value *codegen(Context &C) override;
+};
+
+// An explicit conversion between numeric types, written as a call to the
+// type: int(x), int64(x), float(x) or double(x). Converting a float out of
+// range of the integer type is undefined.
+class ConvertExprNode : public ExprNode {
+  grace::Type *ToTy;
+  ExprNode *RHS;
+
+public:
+  ConvertExprNode(const yy::location &loc, grace::Type *ToTy, ExprNode *RHS)
+      : ExprNode(loc), ToTy(ToTy), RHS(RHS) {}
+
+  ExprNode *getRHS() const { return RHS; }
+
+  void dumpAST(std::ostream &os, unsigned level) const override;
+
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -342,7 +564,7 @@ class ExprNotNode : public ExprNode {
   ExprNode *RHS;
 
 public:
-  ExprNotNode(const yy::location &loc, ExprNode *RHS) : Node(loc), RHS(RHS) {}
+  ExprNotNode(const yy::location &loc, ExprNode *RHS) : ExprNode(loc), RHS(RHS) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(NOT " << std::endl;
@@ -350,7 +572,11 @@ public:
     os << ")" << std::endl;
   }
 
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
+  void codegenCond(Context &C, llvm::BasicBlock *True,
+                   llvm::BasicBlock *False) override;
 };
 
 class ExprOperationNode : public ExprNode {
@@ -359,7 +585,11 @@ class ExprOperationNode : public ExprNode {
 
 public:
   ExprOperationNode(const yy::location &loc, ExprNode *LHS, BinOp Op, ExprNode *RHS)
-      : Node(loc), LHS(LHS), Op(Op), RHS(RHS) {}
+      : ExprNode(loc), LHS(LHS), Op(Op), RHS(RHS) {}
+
+  ExprNode *getLHS() const { return LHS; }
+  ExprNode *getRHS() const { return RHS; }
+  BinOp getOp() const { return Op; }
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(expr" << std::endl;
@@ -369,16 +599,32 @@ public:
     os << NestedLevel(level) << ")" << std::endl;
   }
 
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
+  void codegenCond(Context &C, llvm::BasicBlock *True,
+                   llvm::BasicBlock *False) override;
 };
 
+// What a call to the likely() or unlikely() builtin tells the optimizer
+// about its argument.
+enum class BranchHint { None, Likely, Unlikely };
+
 class CallExprNode : public ExprNode {
-  std::string Callee;
+  Identifier Callee;
   ExprList *Args;
 
 public:
-  CallExprNode(const yy::location &loc, std::string Callee, ExprList *Args)
-      : Node(loc), Callee(std::move(Callee)), Args(Args) {}
+  // Set by Sema when the callee is the likely() or unlikely() builtin, which
+  // yields its argument and weights the branches taken on it.
+  BranchHint Hint = BranchHint::None;
+
+  // Set by Sema when the callee is the length() builtin, which counts the
+  // bytes of a string.
+  bool IsLength = false;
+
+  CallExprNode(const yy::location &loc, Identifier Callee, ExprList *Args)
+      : ExprNode(loc), Callee(Callee), Args(Args) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(call " << Callee << std::endl
@@ -392,40 +638,96 @@ public:
     os << NestedLevel(level) << ")" << std::endl;
   }
 
+  ExprNode *simplify(Simplifier &S) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
+  void codegenCond(Context &C, llvm::BasicBlock *True,
+                   llvm::BasicBlock *False) override;
+};
+
+// An annotation in front of a loop, such as @unroll(4), as written. Sema
+// checks the name and the argument.
+struct LoopHint {
+  yy::location loc;
+  Identifier Name;
+  int Arg = 0;
+  bool HasArg = false;
+
+  LoopHint() = default;
+  LoopHint(const yy::location &loc, Identifier Name) : loc(loc), Name(Name) {}
+  LoopHint(const yy::location &loc, Identifier Name, int Arg)
+      : loc(loc), Name(Name), Arg(Arg), HasArg(true) {}
 };
 
-class WhileNode : public StmtNode {
+// Whether a loop transformation is requested, forbidden, or left to LLVM.
+enum class HintState { Default, Enable, Disable };
+
+class LoopNode : public StmtNode {
+public:
+  std::vector<LoopHint> Hints;
+
+  // What the hints ask for, filled in by Sema. A count or width of 0 lets
+  // LLVM choose.
+  HintState Unroll = HintState::Default;
+  unsigned UnrollCount = 0;
+  HintState Vectorize = HintState::Default;
+  unsigned VectorizeWidth = 0;
+
+  LoopNode(const yy::location &loc) : StmtNode(loc) {}
+
+protected:
+  void checkHints(Sema &S);
+
+  void dumpHints(std::ostream &os) const {
+    for (auto &Hint : Hints) {
+      os << " @" << Hint.Name;
+      if (Hint.HasArg)
+        os << "(" << Hint.Arg << ")";
+    }
+  }
+};
+
+class WhileNode : public LoopNode {
   ExprNode *Condition;
   BlockNode *Block;
 
 public:
   WhileNode(const yy::location &loc, ExprNode *Condition, BlockNode *Block)
-      : Node(loc), Condition(Condition), Block(Block) {}
+      : LoopNode(loc), Condition(Condition), Block(Block) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
-    os << NestedLevel(level) << "(while" << std::endl;
+    os << NestedLevel(level) << "(while";
+    dumpHints(os);
+    os << std::endl;
     Condition->dumpAST(os, level + 1);
     os << std::endl;
     Block->dumpAST(os, level + 1);
     os << NestedLevel(level) << ")" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
-class ForNode : public StmtNode {
+class ForNode : public LoopNode {
   AssignNode *Start;
   ExprNode *End;
   AssignNode *Step;
   BlockNode *Body;
 
+  // The local variable Start assigns, if the body never assigns it. Set by
+  // Sema, so codegen can tell which values it takes inside the body.
+  Variable *Counter = nullptr;
+
 public:
   ForNode(const yy::location &loc, AssignNode *Start, ExprNode *End, AssignNode *Step, BlockNode *Body)
-      : Node(loc), Start(Start), End(End), Step(Step), Body(Body) {}
+      : LoopNode(loc), Start(Start), End(End), Step(Step), Body(Body) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
-    os << NestedLevel(level) << "(for" << std::endl;
+    os << NestedLevel(level) << "(for";
+    dumpHints(os);
+    os << std::endl;
     Start->dumpAST(os, level + 1);
     os << std::endl;
     End->dumpAST(os, level + 1);
@@ -436,6 +738,8 @@ public:
     os << NestedLevel(level) << ")" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -443,7 +747,7 @@ class ReturnNode : public StmtNode {
   ExprNode *expr;
 
 public:
-    ReturnNode(const yy::location &loc, ExprNode *expr) : Node(loc), expr(expr) {}
+    ReturnNode(const yy::location &loc, ExprNode *expr) : StmtNode(loc), expr(expr) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(return ";
@@ -457,34 +761,36 @@ public:
     }
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
 class StopNode : public StmtNode {
 public:
 
-    StopNode(const yy::location &loc) : Node(loc) {
-
-    }
+  StopNode(const yy::location &loc) : StmtNode(loc) {}
 
     void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(stop)" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
 class SkipNode : public StmtNode {
 public:
 
-    SkipNode(const yy::location &loc) : Node(loc) {
-
-    }
+  SkipNode(const yy::location &loc) : StmtNode(loc) {}
 
     void dumpAST(std::ostream &os, unsigned level) const override {
     os << NestedLevel(level) << "(skip)" << std::endl;
   }
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -492,10 +798,33 @@ class WriteNode : public StmtNode {
   ExprList *Exprs;
 
 public:
-   WriteNode(const yy::location &loc, ExprList *Exprs) : Node(loc), Exprs(Exprs) {}
+   WriteNode(const yy::location &loc, ExprList *Exprs) : StmtNode(loc), Exprs(Exprs) {}
 
   void dumpAST(std::ostream &os, unsigned level) const override {}
 
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
+  llvm::Value *codegen(Context &C) override;
+};
+
+class ReadNode : public StmtNode {
+  // Each a VariableExprNode or an IndexExprNode, read in order. A whole
+  // array is read element by element.
+  ExprList *Targets;
+
+public:
+  ReadNode(const yy::location &loc, ExprList *Targets)
+      : StmtNode(loc), Targets(Targets) {}
+
+  void dumpAST(std::ostream &os, unsigned level) const override {
+    os << NestedLevel(level) << "(read" << std::endl;
+    for (auto Target : *Targets)
+      Target->dumpAST(os, level + 1);
+    os << NestedLevel(level) << ")" << std::endl;
+  }
+
+  void simplify(Simplifier &S, StmtList &Out) override;
+  void check(Sema &S) override;
   llvm::Value *codegen(Context &C) override;
 };
 
@@ -0,0 +1,106 @@
+#ifndef GRACE_ARENA_HH
+#define GRACE_ARENA_HH
+
+#include "llvm/Support/Allocator.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace grace {
+
+// A bump allocator for objects that all die together, such as the AST of one
+// translation unit. Allocation is a pointer increment; objects are never
+// freed one by one. Destructors of objects that need them run in reverse
+// order of construction when the arena is reset or destroyed.
+class Arena {
+  // Kept in the arena itself, so tracking destructors costs no malloc.
+  struct Cleanup {
+    Cleanup *Next;
+    void *Object;
+    void (*Destroy)(void *);
+  };
+
+  llvm::BumpPtrAllocator Alloc;
+  Cleanup *Cleanups = nullptr;
+
+  void runCleanups() {
+    for (; Cleanups; Cleanups = Cleanups->Next)
+      Cleanups->Destroy(Cleanups->Object);
+  }
+
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() { runCleanups(); }
+
+  void *allocate(size_t Size, size_t Alignment) {
+    return Alloc.Allocate(Size, Alignment);
+  }
+
+  // Construct a T in the arena.
+  template <typename T, typename... ArgTys> T *make(ArgTys &&... Args) {
+    void *Mem = allocate(sizeof(T), alignof(T));
+    T *Object = new (Mem) T(std::forward<ArgTys>(Args)...);
+
+    if (!std::is_trivially_destructible<T>::value) {
+      auto C = static_cast<Cleanup *>(allocate(sizeof(Cleanup),
+                                               alignof(Cleanup)));
+      C->Next = Cleanups;
+      C->Object = Object;
+      C->Destroy = [](void *P) { static_cast<T *>(P)->~T(); };
+      Cleanups = C;
+    }
+
+    return Object;
+  }
+
+  // Construct an empty container whose elements also live in the arena.
+  template <typename ListTy> ListTy *makeList() {
+    return make<ListTy>(typename ListTy::allocator_type(*this));
+  }
+
+  // Destroy everything allocated so far and return the memory in one step.
+  void reset() {
+    runCleanups();
+    Alloc.Reset();
+  }
+
+  size_t getBytesAllocated() const { return Alloc.getBytesAllocated(); }
+};
+
+// An STL allocator drawing from an Arena. Memory given back by a growing
+// container is simply abandoned until the arena is reset.
+template <typename T> class ArenaAllocator {
+  template <typename U> friend class ArenaAllocator;
+
+  Arena *A;
+
+public:
+  typedef T value_type;
+
+  ArenaAllocator(Arena &A) : A(&A) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &Other) : A(Other.A) {}
+
+  T *allocate(size_t N) {
+    return static_cast<T *>(A->allocate(N * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *, size_t) {}
+
+  template <typename U> bool operator==(const ArenaAllocator<U> &Other) const {
+    return A == Other.A;
+  }
+
+  template <typename U> bool operator!=(const ArenaAllocator<U> &Other) const {
+    return A != Other.A;
+  }
+};
+
+}; // namespace grace
+
+#endif // GRACE_ARENA_HH
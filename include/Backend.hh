@@ -0,0 +1,45 @@
+#ifndef GRACE_BACKEND_HH
+#define GRACE_BACKEND_HH
+
+#include "Options.hh"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Target/TargetMachine.h"
+#include <memory>
+#include <string>
+
+namespace llvm {
+class Module;
+};
+
+namespace grace {
+
+// Register every target compiled into LLVM. Call once before creating a
+// TargetMachine.
+void initializeTargets();
+
+// Create a TargetMachine for Triple with the CPU, features and codegen level
+// selected in Opts. Return null and report the problem if the target is not
+// available.
+std::unique_ptr<llvm::TargetMachine>
+createTargetMachine(const std::string &Triple, const Options &Opts);
+
+// Run the backend over M, appending the object file or assembly to Buffer.
+// Return false if TM cannot emit files of this type.
+bool emitToBuffer(llvm::Module &M, llvm::TargetMachine &TM,
+                  llvm::TargetMachine::CodeGenFileType FileType,
+                  llvm::SmallVectorImpl<char> &Buffer);
+
+// The file written for Input when no -o is given: "a.out" for executables,
+// otherwise Input with its extension replaced by the one of Kind.
+std::string getDefaultOutput(llvm::StringRef Input, EmitKind Kind);
+
+// Write M to Opts.Output (or the default output for Input) in the form
+// selected by Opts.Emit, linking an executable for EmitKind::Exe. Return 0
+// on success.
+int emitOutput(llvm::Module &M, llvm::TargetMachine &TM, const Options &Opts,
+               llvm::StringRef Input);
+
+}; // namespace grace
+
+#endif // GRACE_BACKEND_HH
@@ -22,6 +22,12 @@ enum class BinOp {
   DIFF,
   AND,
   OR,
+
+  // Only produced by Simplify, never by the parser.
+  SHL,
+  LSHR,
+  ASHR,
+  BITAND,
 };
 }; // namespace grace
 
@@ -0,0 +1,46 @@
+#ifndef GRACE_CACHE_HH
+#define GRACE_CACHE_HH
+
+#include "Options.hh"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <string>
+
+namespace grace {
+
+// An on-disk store of object files addressed by the hash of everything that
+// determines their contents. Entries are written to a temporary file and
+// renamed into place, so concurrent compilers may share one directory.
+class CompileCache {
+  std::string Dir;
+
+public:
+  explicit CompileCache(std::string Dir) : Dir(std::move(Dir)) {}
+
+  // $XDG_CACHE_HOME/grace, or ~/.cache/grace.
+  static std::string getDefaultDir();
+
+  // A digest of the source text of a translation unit.
+  static std::string hashSource(llvm::StringRef Source);
+
+  // The key of the object compiled from the source with digest SourceHash
+  // for the target and codegen settings in Opts. Imports describes the
+  // declarations the source sees from other translation units.
+  static std::string getKey(llvm::StringRef SourceHash, llvm::StringRef Imports,
+                            const std::string &Triple, const Options &Opts);
+
+  // The cached object for Key, or null on a miss.
+  std::unique_ptr<llvm::MemoryBuffer> lookup(llvm::StringRef Key) const;
+
+  // Record Object under Key. Failures only cost a future cache miss and are
+  // not reported.
+  void store(llvm::StringRef Key, llvm::StringRef Object) const;
+
+private:
+  std::string getPath(llvm::StringRef Key) const;
+};
+
+}; // namespace grace
+
+#endif // GRACE_CACHE_HH
@@ -0,0 +1,18 @@
+#ifndef GRACE_COMPILER_HH
+#define GRACE_COMPILER_HH
+
+#include "Options.hh"
+#include <string>
+#include <vector>
+
+namespace grace {
+
+// Compile every file in Files into the output selected by Opts, or run the
+// program when Opts.Run is set. Each file is parsed and compiled by its own
+// Driver and Context on a pool of Opts.Jobs threads; functions defined in one
+// file may be called from the others. Return the process exit code.
+int compile(const std::vector<std::string> &Files, const Options &Opts);
+
+}; // namespace grace
+
+#endif // GRACE_COMPILER_HH
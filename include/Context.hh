@@ -1,46 +1,137 @@
 #pragma once
 
 #include "Log.hh"
+#include "Options.hh"
+#include "SSABuilder.hh"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include <SymbolTable.hh>
 #include <list>
 #include <llvm/IR/PassManager.h>
+#include <memory>
+
+namespace llvm {
+class TargetMachine;
+};
 
 namespace grace {
 static const int INT_SIZE = 32;
+static const int INT64_SIZE = 64;
 static const int BOOL_SIZE = 1;
 
 class Context {
-  llvm::LLVMContext TheContext;
+  std::unique_ptr<llvm::LLVMContext> TheContext;
   llvm::IRBuilder<> TheBuilder;
-  llvm::Module TheModule;
+  std::unique_ptr<llvm::Module> TheModule;
+
+  // A string value, { i8*, i64 }, laid out as grace_string in
+  // runtime/grace_rt.h.
+  llvm::StructType *StringTy;
 
 public:
+  // The identifiers of this unit, shared with the Driver that parsed it.
+  StringPool &Names;
   SymbolTable ST;
+  const Options &Opts;
 
-  Context() : TheBuilder(TheContext), TheModule("grace lang", TheContext) {
-    ReturnFound = false;
-    ExpectReturn = false;
-
+  Context(const Options &Opts, StringPool &Names)
+      : TheContext(std::make_unique<llvm::LLVMContext>()),
+        TheBuilder(*TheContext),
+        TheModule(std::make_unique<llvm::Module>("grace lang", *TheContext)),
+        Names(Names), ST(Names), Opts(Opts) {
     // initialize global scope
     ST.enterScope();
 
-    initializePassManager();
+    StringTy = llvm::StructType::create(
+        {TheBuilder.getInt8PtrTy(), TheBuilder.getInt64Ty()}, "grace.string");
+
+    // Every floating point operation the builder creates carries these.
+    if (Opts.FastMath) {
+      llvm::FastMathFlags FMF;
+      FMF.setFast();
+      TheBuilder.setFastMathFlags(FMF);
+    }
+
     insertPrintfAndScanf();
+    insertRuntime();
   }
 
-  llvm::Module &getModule() { return TheModule; }
-  llvm::LLVMContext &getContext() { return TheModule.getContext(); }
+  llvm::Module &getModule() { return *TheModule; }
+  llvm::LLVMContext &getContext() { return *TheContext; }
   llvm::IRBuilder<> &getBuilder() { return TheBuilder; }
-  void dumpIR() const { TheModule.print(errs(), nullptr); }
+  llvm::StructType *getStringTy() const { return StringTy; }
+  void dumpIR(raw_ostream &OS = errs()) const { TheModule->print(OS, nullptr); }
+
+  // Hand the module and the LLVMContext owning it over to another owner, such
+  // as the JIT. The Context must not generate code afterwards.
+  std::unique_ptr<llvm::Module> takeModule() { return std::move(TheModule); }
+  std::unique_ptr<llvm::LLVMContext> takeContext() {
+    return std::move(TheContext);
+  }
+
+  // Declare a function defined in another translation unit so calls to it
+  // resolve at link time.
+  void declareFunction(const std::string &Name, Type *ReturnTy,
+                       const std::vector<Type *> &Args);
 
-  bool ExpectReturn;
-  bool ReturnFound;
+  // Attach the target CPU and features selected on the command line to F, so
+  // the optimizer and backend may use the host's vector extensions, and the
+  // floating point model of --fast-math.
+  void setTargetAttributes(llvm::Function *F) const;
+
+  // Mark the array parameters of F, which are passed by reference, noalias
+  // and nocapture, and dereferenceable when their size is known.
+  void setArgumentAttributes(llvm::Function *F,
+                             const std::vector<Type *> &Args);
+
+  // A pointer to a constant global holding Str and a terminating null. Every
+  // use of the same string in the module shares one global.
+  llvm::Constant *getGlobalString(llvm::StringRef Str);
+
+  // Run the optimization pipeline for Level over the module. The module's
+  // target triple and data layout must already match TM.
+  void optimize(llvm::TargetMachine &TM, OptLevel Level);
+
+  // The routines of the grace runtime library, see runtime/grace_rt.h.
+  struct RuntimeFunctions {
+    llvm::Function *WriteInt;
+    llvm::Function *WriteInt64;
+    llvm::Function *WriteFloat;
+    llvm::Function *WriteDouble;
+    llvm::Function *WriteBool;
+    llvm::Function *WriteStr;
+    llvm::Function *WriteChars;
+    llvm::Function *Flush;
+    llvm::Function *ReadInt;
+    llvm::Function *ReadInt64;
+    llvm::Function *ReadFloat;
+    llvm::Function *ReadDouble;
+    llvm::Function *ReadBool;
+    llvm::Function *ReadStr;
+    llvm::Function *StrConcat;
+    llvm::Function *StrCompare;
+    llvm::Function *StrEqual;
+  } RT;
+
+  // The block of the function being generated that --overflow=trap checks
+  // branch to. Created on first use in each function.
+  llvm::BasicBlock *TrapBB = nullptr;
+
+  // The values of the locals of the function being generated, under
+  // --direct-ssa.
+  SSABuilder SSA;
+
+  // The smallest and largest value the counter of each enclosing for loop
+  // takes in the loop's body, where the loop shows them.
+  llvm::DenseMap<const Variable *, std::pair<int64_t, int64_t>> CounterRanges;
 
 private:
-  void initializePassManager() {}
+  llvm::StringMap<llvm::Constant *> GlobalStrings;
+
   void insertPrintfAndScanf();
+  void insertRuntime();
 };
 
 }; // namespace grace
\ No newline at end of file
@@ -1,32 +1,65 @@
 #pragma once
 
 #include "AST.hh"
+#include "Arena.hh"
+#include "FastLexer.hh"
 #include "Parser.hh"
+#include "Source.hh"
+#include "llvm/ADT/STLExtras.h"
 #include <map>
+#include <memory>
 #include <string>
 
+// The state of a reentrant flex scanner.
+typedef void *yyscan_t;
+
 // Tell Flex the lexer's prototype
-#define YY_DECL yy::parser::symbol_type yylex(Driver &drv)
+#define YY_DECL yy::parser::symbol_type yylex(Driver &drv, yyscan_t yyscanner)
 
 YY_DECL;
 
 class Driver {
 public:
   Driver();
+  ~Driver();
 
   std::map<std::string, int> variables;
   BlockNode *program;
 
+  // Interns the identifiers and string literals of the file. Outlives the
+  // AST, since the unit's symbol table keeps indexing by its ids.
+  grace::StringPool strings;
+
+  // Intern the string literal TEXT, written with its quotes, as the
+  // characters it stands for: quotes removed and escapes resolved.
+  llvm::StringRef intern_literal(llvm::StringRef text);
+
+  // Owns every AST node, list and parameter built by the parser.
+  grace::Arena arena;
+
+  // Free the whole AST at once, once code generation no longer needs it.
+  void release_ast();
+
   // Run the parser on file F. Return 0 on success.
   int parse(const std::string &f);
 
+  // Run the parser on source text already in memory, reporting locations in
+  // file NAME. Return 0 on success.
+  int parse(const std::string &name, std::unique_ptr<grace::SourceBuffer> src);
+
+  // Run only the scanner over SRC, handing every token up to and including
+  // the end of file to SINK. Return 0 on success.
+  int lex(const std::string &name, std::unique_ptr<grace::SourceBuffer> src,
+          llvm::function_ref<void(const yy::parser::symbol_type &)> sink);
+
   // The Name of the file being parsed.
   std::string file;
 
   // Whether to generate parser debug traces.
   bool trace_parsing;
 
-  // Handling the scanner.
+  // Handling the scanner. Each Driver has its own scanner state, so several
+  // Drivers may scan at once.
   void scan_begin();
 
   void scan_end();
@@ -34,9 +67,21 @@ public:
   // Whether to generate scanner debug traces.
   bool trace_scanning;
 
-  bool dump_ast;
-  bool dump_ir;
+  // Whether to scan with the hand-written FastLexer instead of flex.
+  bool use_fast_lexer;
 
   // The token's location used by the scanner.
   yy::location location;
+
+  // The text being scanned and the scanner state, flex's or FastLexer's.
+  std::unique_ptr<grace::SourceBuffer> source;
+  yyscan_t scanner;
+  std::unique_ptr<grace::FastLexer> fast_lexer;
 };
+
+// The parser's entry point into the scanner.
+inline yy::parser::symbol_type yylex(Driver &drv) {
+  if (drv.fast_lexer)
+    return drv.fast_lexer->next();
+  return yylex(drv, drv.scanner);
+}
@@ -0,0 +1,51 @@
+#ifndef GRACE_FASTLEXER_HH
+#define GRACE_FASTLEXER_HH
+
+#include "Parser.hh"
+#include "llvm/ADT/StringRef.h"
+
+class Driver;
+
+namespace grace {
+
+// A hand-written scanner producing the same tokens as Scanner.ll, selected
+// with --lexer=fast. Runs of blanks, comments, identifiers, numbers and
+// string literal bodies are skipped 16 or 32 bytes at a time with SSE2 or
+// AVX2, picked at run time. Line and column numbers are not tracked per
+// character: they are computed from byte offsets when a token is made, by
+// counting the newlines skipped since the previous token.
+//
+// Unlike the flex scanner, a string literal spanning lines advances the line
+// number of the tokens after it.
+class FastLexer {
+  Driver &Drv;
+  const char *Cur;
+  const char *End;
+
+  // Newlines before Counted have been counted into Line, which starts at
+  // LineStart.
+  const char *Counted;
+  const char *LineStart;
+  unsigned Line = 1;
+
+  yy::position getPosition(const char *P);
+  yy::location getLocation(const char *Begin, const char *End);
+
+  yy::parser::symbol_type lexIdentifier(const char *Begin);
+  yy::parser::symbol_type lexNumber(const char *Begin);
+  // The rest of a literal with a fraction or an exponent, ending at Cur.
+  yy::parser::symbol_type lexFloat(const char *Begin);
+  yy::parser::symbol_type lexString(const char *Begin);
+  yy::parser::symbol_type lexPunctuation(const char *Begin);
+
+public:
+  FastLexer(Driver &Drv, llvm::StringRef Source);
+
+  // The next token; the end of file token once the source is exhausted.
+  // Throws yy::parser::syntax_error on invalid input, like the flex scanner.
+  yy::parser::symbol_type next();
+};
+
+}; // namespace grace
+
+#endif // GRACE_FASTLEXER_HH
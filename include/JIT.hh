@@ -0,0 +1,34 @@
+#ifndef GRACE_JIT_HH
+#define GRACE_JIT_HH
+
+#include "Options.hh"
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class LLVMContext;
+class MemoryBuffer;
+class Module;
+}; // namespace llvm
+
+namespace grace {
+
+// A module together with the LLVMContext that owns it.
+typedef std::pair<std::unique_ptr<llvm::Module>,
+                  std::unique_ptr<llvm::LLVMContext>>
+    OwnedModule;
+
+// Compile Modules in process with an ORC LLJIT instance, load the already
+// compiled Objects next to them and call the main function. Modules and
+// objects may call each other's functions; the runtime library and external
+// symbols such as printf and scanf resolve against the grace process itself.
+// Return the value returned by main, or -1 if the program could not be
+// loaded or no main function exists.
+int runJIT(std::vector<OwnedModule> Modules,
+           std::vector<std::unique_ptr<llvm::MemoryBuffer>> Objects,
+           const Options &Opts);
+
+}; // namespace grace
+
+#endif // GRACE_JIT_HH
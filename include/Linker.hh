@@ -0,0 +1,20 @@
+#ifndef GRACE_LINKER_HH
+#define GRACE_LINKER_HH
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace grace {
+
+// Link the in-memory object files Objects against the grace runtime library
+// and the C library into an executable at Output. With lld available the
+// link runs inside the grace process; otherwise the system C compiler driver
+// is used. Return false and report the problem on failure.
+bool linkExecutable(llvm::ArrayRef<llvm::MemoryBufferRef> Objects,
+                    llvm::StringRef Output, const llvm::Triple &TT);
+
+}; // namespace grace
+
+#endif // GRACE_LINKER_HH
@@ -1,24 +1,82 @@
+//
+// Created by Guilherme Souza on 12/7/18.
+//
 #pragma once
 
 #include "llvm/Support/raw_ostream.h"
 #include "location.hh"
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <utility>
 
 using namespace llvm;
 
+// A diagnostic being composed with operator<<. The text is collected in a
+// private buffer and written to stderr in one piece when the Diagnostic goes
+// away, so messages from several compiler threads never interleave.
+class Diagnostic {
+  std::string Message;
+  raw_string_ostream OS;
+  bool Active = true;
+
+public:
+  Diagnostic() : OS(Message) {}
+
+  Diagnostic(Diagnostic &&Other) : OS(Message) {
+    Other.OS.flush();
+    Message = std::move(Other.Message);
+    Other.Active = false;
+  }
+
+  Diagnostic(const Diagnostic &) = delete;
+  Diagnostic &operator=(const Diagnostic &) = delete;
+
+  ~Diagnostic() {
+    if (!Active)
+      return;
+
+    OS.flush();
+    std::lock_guard<std::mutex> Lock(outputMutex());
+    errs() << Message;
+  }
+
+  template <typename T> Diagnostic &operator<<(const T &Value) {
+    OS << Value;
+    return *this;
+  }
+
+  // Serializes every write to stderr made through a Diagnostic.
+  static std::mutex &outputMutex() {
+    static std::mutex Mutex;
+    return Mutex;
+  }
+};
+
 class Log {
 public:
 
-   static raw_ostream &error(const yy::position &pos) {
-       errs() << pos.line << "," << pos.column << ": \033[1;31merror\033[0m: ";
-       return errs();
+   static Diagnostic error(const yy::position &pos) {
+       Diagnostic D;
+       D << prefix(pos) << "\033[1;31merror\033[0m: ";
+       return D;
    }
 
-   static raw_ostream &warning(const yy::position &pos) {
-       errs() << pos.line << "," << pos.column << ": \033[1;33mwarning\033[0m: ";
-       return errs();
+   static Diagnostic warning(const yy::position &pos) {
+       Diagnostic D;
+       D << prefix(pos) << "\033[1;33mwarning\033[0m: ";
+       return D;
    }
 
+   // A message that is not tied to a source position.
+   static Diagnostic message() { return Diagnostic(); }
+
+private:
+   static std::string prefix(const yy::position &pos) {
+       std::string P;
+       if (pos.filename)
+           P = *pos.filename + ":";
+       return P + std::to_string(pos.line) + "," + std::to_string(pos.column) +
+              ": ";
+   }
 };
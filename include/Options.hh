@@ -0,0 +1,118 @@
+#ifndef GRACE_OPTIONS_HH
+#define GRACE_OPTIONS_HH
+
+#include "llvm/Support/CodeGen.h"
+#include <string>
+
+namespace grace {
+
+// Optimization levels accepted on the command line (-O0 ... -O3, -Os).
+enum class OptLevel { O0, O1, O2, O3, Os };
+
+// The scanner reading the sources (--lexer=...): the flex scanner or the
+// hand-written one in FastLexer.cc.
+enum class LexerKind { Flex, Fast };
+
+// What signed int arithmetic does on overflow (--overflow=...): wrap around,
+// trap, or leave the result undefined so LLVM may assume it never happens,
+// as C does.
+enum class OverflowKind { Wrap, Trap, Undefined };
+
+// What the compiler writes out (--emit=...). Exe is a linked executable.
+enum class EmitKind { Exe, Obj, Asm, LLVM, BC };
+
+// Settings shared by every stage of a compilation, filled in by main.cc.
+struct Options {
+  OptLevel Opt = OptLevel::O0;
+
+  // Target CPU and comma separated subtarget features ("+avx2,-fma"), handed
+  // to the TargetMachine and attached to every emitted function. Features is
+  // HostFeatures, those of the last -march=native, followed by the -mattr=
+  // ones, so explicit features win whichever flag came first.
+  std::string CPU = "generic";
+  std::string Features;
+  std::string HostFeatures;
+  std::string ExplicitFeatures;
+
+  OverflowKind Overflow = OverflowKind::Undefined;
+
+  // Build SSA form for locals while generating code instead of giving each
+  // one a stack slot for mem2reg to promote (--direct-ssa).
+  bool DirectSSA = false;
+
+  // Trap on array indices out of bounds (--bounds-check), except where the
+  // index is known to be in range. Arrays passed as a[] have no known size
+  // and are never checked.
+  bool BoundsCheck = false;
+
+  // Let float and double arithmetic ignore NaNs, infinities and the sign of
+  // zero, and be reassociated, so reductions vectorize (--fast-math).
+  bool FastMath = false;
+
+  // Execute the program in process through the JIT instead of writing an
+  // executable (--run).
+  bool Run = false;
+
+  // Output kind and path (-o). An empty Output selects a default name.
+  EmitKind Emit = EmitKind::Exe;
+  std::string Output;
+
+  // Number of translation units compiled at the same time (-j). Zero picks
+  // one per hardware core.
+  unsigned Jobs = 0;
+
+  // Directory of the object cache (--cache, --cache-dir=). Empty disables
+  // caching.
+  std::string CacheDir;
+
+  LexerKind Lexer = LexerKind::Flex;
+
+  // Only scan the inputs, printing every token (--dump-tokens) or the
+  // scanner's throughput (--lex-only).
+  bool DumpTokens = false;
+  bool LexOnly = false;
+
+  // Debugging output (-p, -s, --dump-ast, --dump-ir).
+  bool TraceParsing = false;
+  bool TraceScanning = false;
+  bool DumpAST = false;
+  bool DumpIR = false;
+
+  // Every setting above that changes the generated object code, as text.
+  // Settings added here must be added to the fingerprint as well, otherwise
+  // the object cache hands out stale objects.
+  std::string getCodegenFingerprint() const;
+};
+
+// The outcome of handing a command line argument to one of the parsers below
+// that take a value: not theirs, parsed, or theirs but with a value that was
+// reported as invalid.
+enum class ArgResult { NotMatched, Parsed, Invalid };
+
+// Parse "-O0", "-O1", "-O2", "-O3" or "-Os" into Level. Return false if Arg
+// is not an optimization flag.
+bool parseOptLevel(const std::string &Arg, OptLevel &Level);
+
+// Parse "-march=", "-mcpu=" and "-mattr=" into Opts. "native" as CPU selects
+// the host CPU together with all of its detected features. Return false if
+// Arg is not a target flag.
+bool parseTargetOption(const std::string &Arg, Options &Opts);
+
+// Parse "--emit=obj|asm|llvm|bc|exe" into Kind. An unknown kind is reported
+// and leaves Kind untouched.
+ArgResult parseEmitKind(const std::string &Arg, EmitKind &Kind);
+
+// Parse "--overflow=wrap|trap|undefined" into Kind. An unknown kind is
+// reported and leaves Kind untouched.
+ArgResult parseOverflowKind(const std::string &Arg, OverflowKind &Kind);
+
+// Parse "--lexer=flex|fast" into Kind. An unknown lexer is reported and
+// leaves Kind untouched.
+ArgResult parseLexerKind(const std::string &Arg, LexerKind &Kind);
+
+// The backend optimization level matching an IR optimization level.
+llvm::CodeGenOpt::Level getCodeGenOptLevel(OptLevel Level);
+
+}; // namespace grace
+
+#endif // GRACE_OPTIONS_HH
@@ -0,0 +1,60 @@
+#ifndef GRACE_SSABUILDER_HH
+#define GRACE_SSABUILDER_HH
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/ValueHandle.h"
+#include <utility>
+
+namespace grace {
+
+class Variable;
+
+// Builds SSA form for local variables while their function is generated,
+// after Braun et al., "Simple and Efficient Construction of Static Single
+// Assignment Form" (CC 2013). Codegen records every assignment with write()
+// and asks read() for the value reaching a use; phis are placed on demand
+// and trivial ones removed again, so no allocas, loads or stores are emitted.
+//
+// A block must be sealed once all of its predecessors are known. Reading a
+// variable in an unsealed block, such as a loop header before its back edge
+// exists, leaves an incomplete phi that gets its operands at seal().
+class SSABuilder {
+  typedef std::pair<const Variable *, llvm::BasicBlock *> DefKey;
+
+  // Tracking handles follow replaceAllUsesWith, so definitions stay valid
+  // when a trivial phi is replaced.
+  llvm::DenseMap<DefKey, llvm::WeakTrackingVH> CurrentDef;
+  llvm::DenseMap<llvm::BasicBlock *,
+                 llvm::SmallVector<std::pair<const Variable *, llvm::PHINode *>,
+                                   4>>
+      IncompletePhis;
+  llvm::SmallPtrSet<llvm::BasicBlock *, 32> Sealed;
+  llvm::SmallPtrSet<llvm::PHINode *, 8> Filling;
+
+  llvm::Value *readRecursive(const Variable *V, llvm::Type *Ty,
+                             llvm::BasicBlock *BB);
+  llvm::Value *addPhiOperands(const Variable *V, llvm::PHINode *Phi);
+  llvm::Value *tryRemoveTrivialPhi(llvm::PHINode *Phi);
+
+public:
+  void write(const Variable *V, llvm::BasicBlock *BB, llvm::Value *Val) {
+    CurrentDef[{V, BB}] = Val;
+  }
+
+  // The value of V, of type Ty, at the end of what has been generated of
+  // BB. A variable read before any assignment is undef.
+  llvm::Value *read(const Variable *V, llvm::Type *Ty, llvm::BasicBlock *BB);
+
+  void seal(llvm::BasicBlock *BB);
+
+  // Forget everything about the previous function.
+  void clear();
+};
+
+}; // namespace grace
+
+#endif // GRACE_SSABUILDER_HH
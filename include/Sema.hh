@@ -0,0 +1,60 @@
+#ifndef GRACE_SEMA_HH
+#define GRACE_SEMA_HH
+
+#include "AST.hh"
+#include "Log.hh"
+#include "SymbolTable.hh"
+#include "Type.hh"
+#include "llvm/ADT/StringRef.h"
+#include <vector>
+
+namespace grace {
+
+// Semantic analysis of one unit. Sema resolves every name to its declaration
+// and gives every expression its type, so codegen can trust the tree and
+// never inspects LLVM values to learn what they are. Checking carries on
+// after an error to report as many as possible in one run.
+class Sema {
+  unsigned Errors = 0;
+
+public:
+  SymbolTable ST;
+
+  // The function whose body is being checked. ReturnTy is null inside a
+  // procedure.
+  Identifier FuncName;
+  Type *ReturnTy = nullptr;
+  bool ReturnFound = false;
+
+  // How many loops enclose the statement being checked.
+  unsigned LoopDepth = 0;
+
+  // The likely(), unlikely() and length() builtins. Functions of the same
+  // name defined by the program hide them.
+  FuncSymbol *Likely;
+  FuncSymbol *Unlikely;
+  FuncSymbol *Length;
+
+  explicit Sema(StringPool &Names);
+
+  // Make a function defined in another unit callable from this one.
+  void declareFunction(llvm::StringRef Name, Type *ReturnTy,
+                       const std::vector<Type *> &Args);
+
+  // Check the whole program and report whether it may be compiled.
+  bool check(BlockNode &Program);
+
+  // Report an error; the unit will not reach codegen.
+  Diagnostic error(const yy::position &Pos) {
+    ++Errors;
+    return Log::error(Pos);
+  }
+
+  // Check that E has type Expected, as in a condition or an operand of '!'.
+  // An expression that is already ill-typed has been reported and passes.
+  void expect(ExprNode *E, Type *Expected);
+};
+
+}; // namespace grace
+
+#endif // GRACE_SEMA_HH
@@ -0,0 +1,50 @@
+#ifndef GRACE_SIMPLIFY_HH
+#define GRACE_SIMPLIFY_HH
+
+#include "AST.hh"
+#include "Arena.hh"
+#include "Options.hh"
+#include "llvm/ADT/DenseMap.h"
+
+namespace grace {
+
+// Simplifies a checked AST before codegen: folds constant subtrees,
+// replaces variables that are only ever assigned a constant by that
+// constant, turns multiplications, divisions and remainders by powers of two
+// into shifts and masks, and removes branches and loops whose condition is
+// constant as well as statements after a return, skip or stop. Nodes it
+// creates live in the unit's arena and carry the types Sema would give them.
+// Under --overflow=trap, arithmetic that overflows is left for run time.
+class Simplifier {
+  Arena &A;
+  OverflowKind Overflow;
+  llvm::DenseMap<const Variable *, LiteralNode *> Constants;
+
+public:
+  Simplifier(Arena &A, OverflowKind Overflow) : A(A), Overflow(Overflow) {}
+
+  OverflowKind getOverflow() const { return Overflow; }
+
+  void simplify(BlockNode &Program) { Program.simplify(*this); }
+
+  // The constant every read of V yields, or null.
+  LiteralNode *getConstant(const Variable *V) const {
+    return Constants.lookup(V);
+  }
+
+  void setConstant(const Variable *V, LiteralNode *Value) {
+    Constants[V] = Value;
+  }
+
+  LiteralIntNode *makeInt(const yy::location &Loc, int Value);
+  LiteralInt64Node *makeInt64(const yy::location &Loc, int64_t Value);
+  LiteralFloatNode *makeFloat(const yy::location &Loc, double Value,
+                              bool IsDouble);
+  LiteralBoolNode *makeBool(const yy::location &Loc, bool Value);
+  ExprNode *makeOperation(const yy::location &Loc, ExprNode *LHS, BinOp Op,
+                          ExprNode *RHS);
+};
+
+}; // namespace grace
+
+#endif // GRACE_SIMPLIFY_HH
@@ -0,0 +1,46 @@
+#ifndef GRACE_SOURCE_HH
+#define GRACE_SOURCE_HH
+
+#include "llvm/ADT/StringRef.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace grace {
+
+// The text of one translation unit, laid out the way flex's yy_scan_buffer
+// wants it: writable and followed by two NUL bytes, so the scanner works on
+// it in place. Files are mapped copy-on-write rather than read, so scanning a
+// large file copies nothing and only touches the pages it visits.
+class SourceBuffer {
+  char *Data = nullptr;
+  size_t Size = 0;
+
+  // The length of the mapping, or 0 if Data came from new[].
+  size_t MappedLength = 0;
+
+  SourceBuffer() = default;
+
+public:
+  SourceBuffer(const SourceBuffer &) = delete;
+  SourceBuffer &operator=(const SourceBuffer &) = delete;
+  ~SourceBuffer();
+
+  // Map the file at Path, or read standard input when Path is "-". Report
+  // the error and return null if it cannot be read.
+  static std::unique_ptr<SourceBuffer> fromFile(const std::string &Path);
+
+  // Copy source text handed over by an API caller.
+  static std::unique_ptr<SourceBuffer> fromString(llvm::StringRef Text);
+
+  // The source text, without the terminators.
+  llvm::StringRef getBuffer() const { return llvm::StringRef(Data, Size); }
+
+  // The buffer for yy_scan_buffer, terminators included.
+  char *getScanBuffer() { return Data; }
+  size_t getScanSize() const { return Size + 2; }
+};
+
+}; // namespace grace
+
+#endif // GRACE_SOURCE_HH
@@ -0,0 +1,63 @@
+#ifndef GRACE_STRINGPOOL_HH
+#define GRACE_STRINGPOOL_HH
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/raw_ostream.h"
+#include <ostream>
+
+namespace grace {
+
+// A handle to a string interned in a StringPool. Identifiers from the same
+// pool compare by pointer, and each carries a small dense id suitable for
+// indexing tables.
+class Identifier {
+  typedef llvm::StringMapEntry<unsigned> EntryTy;
+  const EntryTy *Entry = nullptr;
+
+  explicit Identifier(const EntryTy *Entry) : Entry(Entry) {}
+  friend class StringPool;
+
+public:
+  Identifier() = default;
+
+  // Numbered from 0 in order of first interning.
+  unsigned getId() const { return Entry->getValue(); }
+  llvm::StringRef str() const { return Entry->getKey(); }
+
+  explicit operator bool() const { return Entry != nullptr; }
+  bool operator==(Identifier Other) const { return Entry == Other.Entry; }
+  bool operator!=(Identifier Other) const { return Entry != Other.Entry; }
+};
+
+inline std::ostream &operator<<(std::ostream &OS, Identifier Id) {
+  return OS.write(Id.str().data(), Id.str().size());
+}
+
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, Identifier Id) {
+  return OS << Id.str();
+}
+
+// Owns one copy of every distinct identifier of a translation unit. Not
+// thread safe; each unit has its own pool.
+class StringPool {
+  llvm::StringMap<unsigned, llvm::BumpPtrAllocator> Strings;
+
+public:
+  StringPool() = default;
+  StringPool(const StringPool &) = delete;
+  StringPool &operator=(const StringPool &) = delete;
+
+  Identifier get(llvm::StringRef Str) {
+    auto Result = Strings.insert(std::make_pair(Str, unsigned(Strings.size())));
+    return Identifier(&*Result.first);
+  }
+
+  // One more than the largest id handed out so far.
+  unsigned size() const { return Strings.size(); }
+};
+
+}; // namespace grace
+
+#endif // GRACE_STRINGPOOL_HH
@@ -1,4 +1,3 @@
-
 //
 // Created by Guilherme Souza on 12/7/18.
 //
@@ -6,76 +5,136 @@
 #ifndef GRACE_SYMBOLTABLE_HH
 #define GRACE_SYMBOLTABLE_HH
 
-#include <list>
-#include <unordered_map>
+#include <memory>
+#include <new>
 #include <utility>
+#include <vector>
 
+#include "StringPool.hh"
 #include "Type.hh"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/Casting.h"
 
 namespace grace {
 
+class Variable;
+
+enum class SymbolKind { Variable, Block, Func };
+
+// Symbols carry their kind for llvm::dyn_cast, and are owned by the
+// SymbolTable scope that defined them.
 class Symbol {
+  SymbolKind Kind;
+
+protected:
+  explicit Symbol(SymbolKind Kind) : Kind(Kind) {}
+
 public:
-  virtual ~Symbol() = default;
+  SymbolKind getKind() const { return Kind; }
 };
 
 class VariableSymbol : public Symbol {
 public:
-  llvm::AllocaInst *Alloca;
-  Type *Ty;
+  Variable *Var;
 
-  VariableSymbol(llvm::AllocaInst *Alloca, Type *Ty) : Alloca(Alloca), Ty(Ty) {}
+  VariableSymbol(Variable *Var) : Symbol(SymbolKind::Variable), Var(Var) {}
+
+  static bool classof(const Symbol *S) {
+    return S->getKind() == SymbolKind::Variable;
+  }
 };
 
 class BlockSymbol : public Symbol {
 public:
   llvm::BasicBlock *BB;
 
-  BlockSymbol(llvm::BasicBlock *BB) : BB(BB) {}
+  BlockSymbol(llvm::BasicBlock *BB) : Symbol(SymbolKind::Block), BB(BB) {}
+
+  static bool classof(const Symbol *S) {
+    return S->getKind() == SymbolKind::Block;
+  }
 };
 
 class FuncSymbol : public Symbol {
 public:
+  // Null in Sema's table, which only needs the signature.
   llvm::Function *Function;
   Type *ReturnTy;
   std::vector<Type *> Args;
 
   FuncSymbol(llvm::Function *Function, Type *ReturnTy, std::vector<Type *> Args)
-      : Function(Function), ReturnTy(ReturnTy), Args(std::move(Args)) {}
+      : Symbol(SymbolKind::Func), Function(Function), ReturnTy(ReturnTy),
+        Args(std::move(Args)) {}
+
+  static bool classof(const Symbol *S) {
+    return S->getKind() == SymbolKind::Func;
+  }
 };
 
+// Maps identifiers to the innermost symbol bound to them. Bindings live in a
+// flat array indexed by identifier id, so get() is a single load. Every set()
+// records the binding it shadows on an undo stack, and leaveScope() pops the
+// scope's entries to restore them. Symbols are allocated from slabs that are
+// rewound at scope exit, so they cost no malloc once the slabs exist.
 class SymbolTable {
-  std::list<std::unordered_map<std::string, Symbol *>> Scopes;
+  struct Shadowed {
+    unsigned Id;
+    Symbol *Previous;
+  };
+
+  struct Mark {
+    size_t UndoSize;
+    size_t Slab;
+    size_t Offset;
+  };
+
+  static const size_t SlabSize = 4096;
+
+  StringPool &Names;
+  std::vector<Symbol *> Bindings;
+  std::vector<Shadowed> Undo;
+  std::vector<Mark> Scopes;
+
+  std::vector<std::unique_ptr<char[]>> Slabs;
+  size_t CurSlab = 0;
+  size_t CurOffset = 0;
+
+  void *allocate(size_t Size, size_t Alignment);
+  void bind(Identifier Id, Symbol *Sym);
+  static void destroy(Symbol *Sym);
 
 public:
-  Symbol *get(const std::string &Identifier) const {
-    for (const auto &Scope : Scopes) {
-      auto it = Scope.find(Identifier);
-      if (it != Scope.end())
-        return it->second;
-    }
-
-    return nullptr;
+  explicit SymbolTable(StringPool &Names) : Names(Names) {}
+  SymbolTable(const SymbolTable &) = delete;
+  SymbolTable &operator=(const SymbolTable &) = delete;
+  ~SymbolTable();
+
+  Symbol *get(Identifier Id) const {
+    return Id.getId() < Bindings.size() ? Bindings[Id.getId()] : nullptr;
   }
 
-  void set(const std::string &Identifier, Symbol *Sym) {
-    if (get(Identifier) == nullptr)
-      Scopes.back()[Identifier] = Sym;
+  Symbol *get(llvm::StringRef Name) const { return get(Names.get(Name)); }
+
+  // Create a SymbolTy in the current scope and bind Id to it, shadowing any
+  // outer binding until the scope is left.
+  template <typename SymbolTy, typename... ArgTys>
+  SymbolTy *set(Identifier Id, ArgTys &&... Args) {
+    void *Mem = allocate(sizeof(SymbolTy), alignof(SymbolTy));
+    auto Sym = new (Mem) SymbolTy(std::forward<ArgTys>(Args)...);
+    bind(Id, Sym);
+    return Sym;
   }
 
-  void enterScope() {
-    Scopes.emplace_back();
+  template <typename SymbolTy, typename... ArgTys>
+  SymbolTy *set(llvm::StringRef Name, ArgTys &&... Args) {
+    return set<SymbolTy>(Names.get(Name), std::forward<ArgTys>(Args)...);
   }
 
-  void leaveScope() {
-//      auto Back = *Scopes.end();
-//      for (auto &Entry : Back)
-//          delete Entry.second;
+  void enterScope();
 
-      Scopes.pop_back();
-  }
+  // Destroy the symbols of the innermost scope and restore what they hid.
+  void leaveScope();
 };
 }; // namespace grace
 
@@ -4,8 +4,11 @@
 
 #pragma once
 
-#include "AST.hh"
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <utility>
 
 namespace llvm {
 class Type;
@@ -14,42 +17,93 @@ class Type;
 namespace grace {
 class Context;
 
+enum class TypeKind { Int, Int64, Float, Double, Bool, String, Array };
+
+// A grace type. Types are interned by the TypeContext: there is exactly one
+// Type object per distinct type, so two types are equal exactly when their
+// pointers are, and a kind check is a compare of the tag.
 class Type {
+  TypeKind Kind;
+
+  // Arrays only. A size of 0 is an array parameter declared as a[], which
+  // accepts arrays of any size.
+  Type *Element = nullptr;
+  unsigned Size = 0;
+
+  explicit Type(TypeKind Kind) : Kind(Kind) {}
+  Type(Type *Element, unsigned Size)
+      : Kind(TypeKind::Array), Element(Element), Size(Size) {}
+  friend class TypeContext;
+
 public:
-  virtual ~Type() = default;
+  Type(const Type &) = delete;
+  Type &operator=(const Type &) = delete;
+
+  TypeKind getKind() const { return Kind; }
+
+  // The LLVM type of a value of this type. Arrays are [N x T]; an array
+  // without a size has no value type and is only passed by reference.
+  llvm::Type *emit(Context &C) const;
+
+  // The LLVM type of a parameter of this type. Arrays are passed by
+  // reference, as a pointer to their first element.
+  llvm::Type *emitParam(Context &C) const;
 
-  virtual llvm::Type *emit(Context &C) = 0;
-  virtual std::string str() const = 0;
+  std::string str() const;
 
-  static Type *from(llvm::Type *Ty);
   static Type *boolTy();
   static Type *intTy();
+  static Type *int64Ty();
+  static Type *floatTy();
+  static Type *doubleTy();
   static Type *strTy();
+  static Type *arrayTy(Type *Element, unsigned Size);
 
-  bool operator==(const Type &Other);
-  bool operator!=(const Type &Other);
+  bool isIntTy() const { return Kind == TypeKind::Int; }
+  bool isInt64Ty() const { return Kind == TypeKind::Int64; }
+  bool isFloatTy() const { return Kind == TypeKind::Float; }
+  bool isDoubleTy() const { return Kind == TypeKind::Double; }
+  bool isBoolTy() const { return Kind == TypeKind::Bool; }
+  bool isStringTy() const { return Kind == TypeKind::String; }
+  bool isArrayTy() const { return Kind == TypeKind::Array; }
 
-  bool isIntTy() const;
-  bool isBoolTy() const;
-  bool isStringTy() const;
-};
+  // int or int64.
+  bool isIntegerTy() const { return isIntTy() || isInt64Ty(); }
+  // float or double.
+  bool isFloatingPointTy() const { return isFloatTy() || isDoubleTy(); }
+  // The types arithmetic and explicit conversions apply to.
+  bool isNumericTy() const { return isIntegerTy() || isFloatingPointTy(); }
 
-class IntType : public Type {
-public:
-  llvm::Type *emit(Context &C) override;
-  std::string str() const override { return "int"; }
+  Type *getElementType() const { return Element; }
+  unsigned getArraySize() const { return Size; }
 };
 
-class BoolType : public Type {
-public:
-  llvm::Type *emit(Context &C) override;
-  std::string str() const override { return "bool"; }
-};
+// Owns the interned types. There is one TypeContext per process, shared by
+// every compilation thread. The scalar types are fixed; array types are
+// created on first use under a lock.
+class TypeContext {
+  Type IntTy{TypeKind::Int};
+  Type Int64Ty{TypeKind::Int64};
+  Type FloatTy{TypeKind::Float};
+  Type DoubleTy{TypeKind::Double};
+  Type BoolTy{TypeKind::Bool};
+  Type StrTy{TypeKind::String};
+
+  std::mutex ArraysLock;
+  std::map<std::pair<Type *, unsigned>, std::unique_ptr<Type>> Arrays;
+
+  TypeContext() = default;
 
-class StringType : public Type {
 public:
-  llvm::Type *emit(Context &C) override;
-  std::string str() const override { return "string"; }
+  static TypeContext &get();
+
+  Type *getIntTy() { return &IntTy; }
+  Type *getInt64Ty() { return &Int64Ty; }
+  Type *getFloatTy() { return &FloatTy; }
+  Type *getDoubleTy() { return &DoubleTy; }
+  Type *getBoolTy() { return &BoolTy; }
+  Type *getStrTy() { return &StrTy; }
+  Type *getArrayTy(Type *Element, unsigned Size);
 };
 
 }; // namespace grace
@@ -1,88 +1,92 @@
-#include "Context.hh"
-#include "Driver.hh"
-#include "llvm/IR/LegacyPassManager.h"
-#include "llvm/IR/Verifier.h"
-#include "llvm/Support/FileSystem.h"
-#include "llvm/Support/TargetRegistry.h"
-#include "llvm/Support/TargetSelect.h"
-#include "llvm/Target/TargetMachine.h"
-#include "llvm/Bitcode/BitcodeWriter.h"
-#include <iostream>
+#include "Cache.hh"
+#include "Compiler.hh"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace grace;
+
+// Parse the value of -j into Jobs. Anything but a non-negative number is
+// reported and leaves Jobs untouched.
+static ArgResult parseJobs(llvm::StringRef Value, unsigned &Jobs) {
+  if (Value.getAsInteger(10, Jobs)) {
+    llvm::errs() << "invalid job count '" << Value
+                 << "', expected a non-negative number\n";
+    return ArgResult::Invalid;
+  }
+
+  return ArgResult::Parsed;
+}
 
 int main(int argc, char **argv) {
-  Driver drv;
+  Options Opts;
+  std::vector<std::string> Files;
+
+  // Invalid arguments are all reported before giving up.
+  bool Invalid = false;
+  auto Matched = [&](ArgResult Result) {
+    Invalid |= Result == ArgResult::Invalid;
+    return Result != ArgResult::NotMatched;
+  };
 
   for (int i = 1; i < argc; ++i) {
     if (argv[i] == std::string("-p")) {
-      drv.trace_parsing = true;
+      Opts.TraceParsing = true;
     } else if (argv[i] == std::string("-s")) {
-      drv.trace_scanning = true;
+      Opts.TraceScanning = true;
     } else if (argv[i] == std::string("--dump-ast")) {
-      drv.dump_ast = true;
+      Opts.DumpAST = true;
     } else if (argv[i] == std::string("--dump-ir")) {
-      drv.dump_ir = true;
-    } else if (!drv.parse(argv[i])) {
-      if (drv.dump_ast)
-        drv.program->dumpAST(std::cout, 0);
+      Opts.DumpIR = true;
+    } else if (argv[i] == std::string("--dump-tokens")) {
+      Opts.DumpTokens = true;
+    } else if (argv[i] == std::string("--lex-only")) {
+      Opts.LexOnly = true;
+    } else if (argv[i] == std::string("--run")) {
+      Opts.Run = true;
+    } else if (argv[i] == std::string("--direct-ssa")) {
+      Opts.DirectSSA = true;
+    } else if (argv[i] == std::string("--bounds-check")) {
+      Opts.BoundsCheck = true;
+    } else if (argv[i] == std::string("--fast-math")) {
+      Opts.FastMath = true;
+    } else if (argv[i] == std::string("--cache")) {
+      Opts.CacheDir = CompileCache::getDefaultDir();
+    } else if (std::strncmp(argv[i], "--cache-dir=", 12) == 0) {
+      Opts.CacheDir = argv[i] + 12;
+    } else if (argv[i] == std::string("-o")) {
+      if (i + 1 == argc) {
+        llvm::errs() << "missing output file after -o\n";
+        Invalid = true;
+      } else
+        Opts.Output = argv[++i];
+    } else if (argv[i] == std::string("-j")) {
+      if (i + 1 == argc) {
+        llvm::errs() << "missing job count after -j\n";
+        Invalid = true;
+      } else
+        Matched(parseJobs(argv[++i], Opts.Jobs));
+    } else if (std::strncmp(argv[i], "-j", 2) == 0) {
+      Matched(parseJobs(argv[i] + 2, Opts.Jobs));
+    } else if (Matched(parseOverflowKind(argv[i], Opts.Overflow))) {
+      continue;
+    } else if (Matched(parseLexerKind(argv[i], Opts.Lexer))) {
+      continue;
+    } else if (Matched(parseEmitKind(argv[i], Opts.Emit))) {
+      continue;
+    } else if (parseOptLevel(argv[i], Opts.Opt)) {
+      continue;
+    } else if (parseTargetOption(argv[i], Opts)) {
+      continue;
+    } else {
+      Files.push_back(argv[i]);
     }
   }
 
-  Context C;
-  drv.program->codegen(C);
-
-  if (drv.dump_ir)
-    C.dumpIR();
-
-  verifyModule(C.getModule());
-
-  InitializeAllTargetInfos();
-  InitializeAllTargets();
-  InitializeAllTargetMCs();
-  InitializeAllAsmParsers();
-  InitializeAllAsmPrinters();
-
-  auto TargetTriple = sys::getDefaultTargetTriple();
-  C.getModule().setTargetTriple(TargetTriple);
-
-  std::string Error;
-  auto Target = TargetRegistry::lookupTarget(TargetTriple, Error);
-
-  if (!Target) {
-    errs() << Error;
-    return -1;
-  }
-
-  auto CPU = "generic";
-  auto Features = "";
-
-  TargetOptions Opt;
-  auto RM = Optional<Reloc::Model>();
-  auto TheTargetMachine =
-      Target->createTargetMachine(TargetTriple, CPU, Features, Opt, RM);
-
-  C.getModule().setDataLayout(TheTargetMachine->createDataLayout());
-
-  std::error_code EC;
-  raw_fd_ostream dest("output.o", EC, sys::fs::F_None);
-
-  if (EC) {
-    errs() << "Could not open file: " << EC.message();
+  if (Invalid)
     return 1;
-  }
-
-  legacy::PassManager pass;
-  auto FileType = TargetMachine::CGFT_ObjectFile;
-
-  if (TheTargetMachine->addPassesToEmitFile(pass, dest, nullptr, FileType)) {
-    errs() << "TheTargetMachine can't emit a file of this type";
-    return 1;
-  }
-
-  pass.run(C.getModule());
-  dest.flush();
-
-  system("clang output.o");
-  system("rm -f output.o");
 
-  return 0;
-}
\ No newline at end of file
+  return compile(Files, Opts);
+}
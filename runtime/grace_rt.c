@@ -0,0 +1,432 @@
+// madvise and MADV_SEQUENTIAL are not part of strict ISO C.
+#define _DEFAULT_SOURCE
+
+#include "grace_rt.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Large enough that programs printing millions of numbers make few system
+// calls.
+#define OUT_SIZE (1 << 16)
+
+// The longest int64, "-9223372036854775808".
+#define INT_DIGITS 20
+
+// Enough for any double printed with %.17g, "-2.2250738585072014e-308".
+#define FLOAT_DIGITS 32
+
+static char Out[OUT_SIZE];
+static size_t OutSize;
+
+// The two digits of every number below 100, so integers are converted two
+// digits per division.
+static const char DigitPairs[] = "00010203040506070809"
+                                 "10111213141516171819"
+                                 "20212223242526272829"
+                                 "30313233343536373839"
+                                 "40414243444546474849"
+                                 "50515253545556575859"
+                                 "60616263646566676869"
+                                 "70717273747576777879"
+                                 "80818283848586878889"
+                                 "90919293949596979899";
+
+// Write all of Iov to standard output, resuming after short writes. Output
+// that cannot be written, say to a closed pipe, is dropped.
+static void writeAll(struct iovec *Iov, int Count) {
+  // Programs may call printf too; what it left in stdio's buffer came first.
+  fflush(stdout);
+
+  while (Count > 0) {
+    ssize_t Written = writev(STDOUT_FILENO, Iov, Count);
+    if (Written < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+
+    while (Count > 0 && (size_t)Written >= Iov->iov_len) {
+      Written -= Iov->iov_len;
+      ++Iov;
+      --Count;
+    }
+    if (Count > 0) {
+      Iov->iov_base = (char *)Iov->iov_base + Written;
+      Iov->iov_len -= Written;
+    }
+  }
+}
+
+void grace_flush(void) {
+  if (!OutSize)
+    return;
+
+  struct iovec Iov = {Out, OutSize};
+  writeAll(&Iov, 1);
+  OutSize = 0;
+}
+
+static void append(const char *Chars, size_t Size) {
+  if (Size <= OUT_SIZE - OutSize) {
+    memcpy(Out + OutSize, Chars, Size);
+    OutSize += Size;
+    return;
+  }
+
+  // Too long for what is left of the buffer: write both with one call.
+  struct iovec Iov[2] = {{Out, OutSize}, {(void *)Chars, Size}};
+  writeAll(Iov, 2);
+  OutSize = 0;
+}
+
+void grace_write_chars(const char *Chars, uint32_t Size) {
+  append(Chars, Size);
+}
+
+static int isLong(const grace_string *S) {
+  return (S->Long.Size & GRACE_STR_LONG) != 0;
+}
+
+static size_t length(const grace_string *S) {
+  if (isLong(S))
+    return S->Long.Size & ~GRACE_STR_LONG;
+  return (unsigned char)S->Short[15];
+}
+
+static const char *data(const grace_string *S) {
+  return isLong(S) ? S->Long.Data : S->Short;
+}
+
+// A string of the Size characters at A followed by the BSize at B. Only
+// strings too long to store inline allocate, and they are never freed.
+static grace_string makeString(const char *A, size_t Size, const char *B,
+                               size_t BSize) {
+  grace_string S;
+  memset(&S, 0, sizeof(S));
+
+  char *Chars = S.Short;
+  if (Size + BSize > GRACE_STR_SHORT_MAX) {
+    Chars = malloc(Size + BSize + 1);
+    if (!Chars) {
+      fprintf(stderr, "grace: out of memory\n");
+      exit(1);
+    }
+    Chars[Size + BSize] = '\0';
+    S.Long.Data = Chars;
+    S.Long.Size = (Size + BSize) | GRACE_STR_LONG;
+  } else {
+    S.Short[15] = (char)(Size + BSize);
+  }
+
+  memcpy(Chars, A, Size);
+  if (BSize)
+    memcpy(Chars + Size, B, BSize);
+  return S;
+}
+
+grace_string grace_str_concat(grace_string A, grace_string B) {
+  return makeString(data(&A), length(&A), data(&B), length(&B));
+}
+
+int32_t grace_str_compare(grace_string A, grace_string B) {
+  size_t ASize = length(&A), BSize = length(&B);
+  int Result = memcmp(data(&A), data(&B), ASize < BSize ? ASize : BSize);
+  if (Result)
+    return Result < 0 ? -1 : 1;
+  return ASize < BSize ? -1 : ASize > BSize;
+}
+
+int32_t grace_str_equal(grace_string A, grace_string B) {
+  size_t Size = length(&A);
+  return Size == length(&B) && !memcmp(data(&A), data(&B), Size);
+}
+
+void grace_write_str(grace_string Str) { append(data(&Str), length(&Str)); }
+
+void grace_write_bool(int32_t Value) {
+  if (Value)
+    append("true", 4);
+  else
+    append("false", 5);
+}
+
+// Append N, preceded by a minus sign if Negative.
+static void writeInteger(uint64_t N, int Negative) {
+  if (OUT_SIZE - OutSize < INT_DIGITS)
+    grace_flush();
+
+  // Convert from the last digit backwards, then copy the digits out.
+  char Digits[INT_DIGITS];
+  char *End = Digits + INT_DIGITS, *P = End;
+
+  while (N >= 100) {
+    unsigned Pair = N % 100;
+    N /= 100;
+    P -= 2;
+    memcpy(P, DigitPairs + 2 * Pair, 2);
+  }
+  if (N >= 10) {
+    P -= 2;
+    memcpy(P, DigitPairs + 2 * N, 2);
+  } else {
+    *--P = (char)('0' + N);
+  }
+  if (Negative)
+    *--P = '-';
+
+  memcpy(Out + OutSize, P, End - P);
+  OutSize += End - P;
+}
+
+void grace_write_int(int32_t Value) {
+  writeInteger(Value < 0 ? 0u - (uint32_t)Value : (uint32_t)Value, Value < 0);
+}
+
+void grace_write_int64(int64_t Value) {
+  writeInteger(Value < 0 ? 0u - (uint64_t)Value : (uint64_t)Value, Value < 0);
+}
+
+void grace_write_float(float Value) {
+  if (OUT_SIZE - OutSize < FLOAT_DIGITS)
+    grace_flush();
+
+  // The fewest digits that read back as the same float.
+  int Size = 0;
+  for (int Precision = 6; Precision <= 9; ++Precision) {
+    Size = snprintf(Out + OutSize, FLOAT_DIGITS, "%.*g", Precision, Value);
+    if (strtof(Out + OutSize, NULL) == Value)
+      break;
+  }
+  OutSize += Size;
+}
+
+void grace_write_double(double Value) {
+  if (OUT_SIZE - OutSize < FLOAT_DIGITS)
+    grace_flush();
+
+  // The fewest digits that read back as the same double; 15 always print
+  // what was written as a literal of up to 15 digits.
+  int Size = 0;
+  for (int Precision = 15; Precision <= 17; ++Precision) {
+    Size = snprintf(Out + OutSize, FLOAT_DIGITS, "%.*g", Precision, Value);
+    if (strtod(Out + OutSize, NULL) == Value)
+      break;
+  }
+  OutSize += Size;
+}
+
+// The input not consumed yet is [In, InEnd). Input that is not mapped is read
+// into InBuffer, after moving the rest of the previous block to its start.
+#define IN_SIZE (1 << 20)
+
+static char InBuffer[IN_SIZE];
+static const char *In = InBuffer;
+static const char *InEnd = InBuffer;
+static int InOpened;
+static int InDone;
+
+// Map a regular file on standard input, from where its offset is now, so
+// reading it needs no copies at all.
+static void openInput(void) {
+  InOpened = 1;
+
+  struct stat St;
+  if (fstat(STDIN_FILENO, &St) != 0 || !S_ISREG(St.st_mode))
+    return;
+
+  off_t Offset = lseek(STDIN_FILENO, 0, SEEK_CUR);
+  if (Offset < 0 || Offset >= St.st_size)
+    return;
+
+  void *Map = mmap(NULL, St.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+  if (Map == MAP_FAILED)
+    return;
+
+  madvise(Map, St.st_size, MADV_SEQUENTIAL);
+  In = (const char *)Map + Offset;
+  InEnd = (const char *)Map + St.st_size;
+  InDone = 1;
+}
+
+// Read more input after what is left, and return whether there is any left
+// now. Only blocks when all input so far has been consumed.
+static int refill(void) {
+  if (!InOpened) {
+    openInput();
+    if (In != InEnd)
+      return 1;
+  }
+  if (InDone)
+    return In != InEnd;
+
+  size_t Left = InEnd - In;
+  memmove(InBuffer, In, Left);
+  In = InBuffer;
+  InEnd = InBuffer + Left;
+
+  // Whatever the program printed may be a prompt for this input.
+  grace_flush();
+
+  for (;;) {
+    ssize_t Read = read(STDIN_FILENO, InBuffer + Left, IN_SIZE - Left);
+    if (Read < 0 && errno == EINTR)
+      continue;
+    if (Read <= 0) {
+      InDone = 1;
+      break;
+    }
+    InEnd += Read;
+    break;
+  }
+
+  return In != InEnd;
+}
+
+__attribute__((noreturn)) static void inputError(const char *Expected) {
+  grace_flush();
+  fprintf(stderr, In == InEnd ? "grace: expected %s, but the input ended\n"
+                              : "grace: expected %s in the input\n",
+          Expected);
+  exit(1);
+}
+
+static int isSpace(char C) {
+  return C == ' ' || C == '\n' || C == '\t' || C == '\r' || C == '\v' ||
+         C == '\f';
+}
+
+// Skip whitespace and return whether a value follows.
+static int skipSpace(void) {
+  for (;;) {
+    while (In != InEnd && isSpace(*In))
+      ++In;
+    if (In != InEnd || !refill())
+      return In != InEnd;
+  }
+}
+
+// Make the whole word at In available in one piece, unless it is longer
+// than the input buffer, and return its length.
+static size_t peekWord(void) {
+  for (;;) {
+    const char *P = In;
+    while (P != InEnd && !isSpace(*P))
+      ++P;
+    if (P != InEnd || InDone || (size_t)(P - In) == IN_SIZE)
+      return P - In;
+
+    // The word may go on in the next block.
+    size_t Seen = P - In;
+    if (!refill() || (size_t)(InEnd - In) == Seen)
+      return InEnd - In;
+  }
+}
+
+// Read a decimal integer whose magnitude is at most Max, or Max + 1 when it
+// is negative, and return it as the two's complement bits of its value.
+static uint64_t readInteger(uint64_t Max, const char *What,
+                            const char *WhatInRange) {
+  if (!skipSpace())
+    inputError(What);
+
+  // An integer is at most 20 characters; make sure no block ends inside it.
+  size_t Size = peekWord();
+  const char *P = In, *End = In + Size;
+
+  int Negative = P != End && *P == '-';
+  if (P != End && (*P == '-' || *P == '+'))
+    ++P;
+  if (P == End)
+    inputError(What);
+
+  uint64_t Value = 0;
+  for (; P != End; ++P) {
+    unsigned Digit = (unsigned)(*P - '0');
+    if (Digit > 9)
+      inputError(What);
+    if (Value > (Max + Negative - Digit) / 10)
+      inputError(WhatInRange);
+    Value = Value * 10 + Digit;
+  }
+
+  In = End;
+  return Negative ? 0u - Value : Value;
+}
+
+int32_t grace_read_int(void) {
+  return (int32_t)(uint32_t)readInteger(INT32_MAX, "an int", "an int in range");
+}
+
+int64_t grace_read_int64(void) {
+  return (int64_t)readInteger(INT64_MAX, "an int64", "an int64 in range");
+}
+
+// Copy the word at In into Buffer, null-terminated, for strtod and strtof,
+// and return its length. Words longer than any number are reported as What.
+static size_t peekNumber(char *Buffer, size_t BufferSize, const char *What) {
+  if (!skipSpace())
+    inputError(What);
+
+  size_t Size = peekWord();
+  if (Size >= BufferSize)
+    inputError(What);
+  memcpy(Buffer, In, Size);
+  Buffer[Size] = '\0';
+  return Size;
+}
+
+float grace_read_float(void) {
+  char Word[64], *End;
+  size_t Size = peekNumber(Word, sizeof(Word), "a float");
+  float Value = strtof(Word, &End);
+  if (End != Word + Size || !Size)
+    inputError("a float");
+  In += Size;
+  return Value;
+}
+
+double grace_read_double(void) {
+  char Word[64], *End;
+  size_t Size = peekNumber(Word, sizeof(Word), "a double");
+  double Value = strtod(Word, &End);
+  if (End != Word + Size || !Size)
+    inputError("a double");
+  In += Size;
+  return Value;
+}
+
+int32_t grace_read_bool(void) {
+  if (!skipSpace())
+    inputError("a bool");
+
+  size_t Size = peekWord();
+  int32_t Value;
+  if (Size == 4 && !memcmp(In, "true", 4))
+    Value = 1;
+  else if (Size == 5 && !memcmp(In, "false", 5))
+    Value = 0;
+  else
+    inputError("true or false");
+
+  In += Size;
+  return Value;
+}
+
+grace_string grace_read_str(void) {
+  if (!skipSpace())
+    inputError("a string");
+
+  size_t Size = peekWord();
+  grace_string Str = makeString(In, Size, NULL, 0);
+  In += Size;
+  return Str;
+}
+
+// Runs when the program returns from main or calls exit.
+__attribute__((destructor)) static void flushAtExit(void) { grace_flush(); }
@@ -0,0 +1,91 @@
+#ifndef GRACE_RT_H
+#define GRACE_RT_H
+
+#include <stdint.h>
+
+// The grace runtime library, linked into every grace executable and into the
+// compiler itself for --run. Output goes to a per-process buffer that is
+// written to standard output when it fills up, at grace_flush() and at exit.
+// Input is read from standard input, mapped into memory when it is a regular
+// file and read in large blocks otherwise.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A grace string value, passed and returned by value in two registers.
+// Strings of up to GRACE_STR_SHORT_MAX characters are stored inline in
+// Short, followed by a null, with their length in the last byte. Longer ones,
+// literals included, point to their null-terminated characters and have
+// GRACE_STR_LONG set in Size, which on the little-endian targets grace
+// supports is the top bit of that last byte. All zeros is the empty string.
+//
+// Strings have no owner: the characters of long strings built at run time,
+// by grace_str_concat or grace_read_str, are never freed. A program that
+// keeps building long strings in a loop grows until it exits.
+typedef union {
+  struct {
+    const char *Data;
+    uint64_t Size;
+  } Long;
+  char Short[16];
+} grace_string;
+
+#define GRACE_STR_SHORT_MAX 14
+#define GRACE_STR_LONG (UINT64_C(1) << 63)
+
+// The concatenation of A and B.
+grace_string grace_str_concat(grace_string A, grace_string B);
+
+// Compare A and B byte by byte, a prefix first: -1, 0 or 1.
+int32_t grace_str_compare(grace_string A, grace_string B);
+
+// Whether A and B hold the same characters.
+int32_t grace_str_equal(grace_string A, grace_string B);
+
+// Append the decimal digits of Value.
+void grace_write_int(int32_t Value);
+void grace_write_int64(int64_t Value);
+
+// Append Value with the fewest digits that read back as the same value, in
+// the style of printf's %g.
+void grace_write_float(float Value);
+void grace_write_double(double Value);
+
+// Append "true" or "false".
+void grace_write_bool(int32_t Value);
+
+// Append the characters of Str.
+void grace_write_str(grace_string Str);
+
+// Append the Size characters at Chars, such as a literal whose length is known
+// at compile time.
+void grace_write_chars(const char *Chars, uint32_t Size);
+
+// Write out everything appended so far.
+void grace_flush(void);
+
+// Read the next whitespace separated value from standard input. Input that
+// ends early or does not hold a value of the type asked for ends the program
+// with an error.
+
+// A decimal int or int64, with an optional sign.
+int32_t grace_read_int(void);
+int64_t grace_read_int64(void);
+
+// A decimal number in any form strtod accepts.
+float grace_read_float(void);
+double grace_read_double(void);
+
+// "true" or "false", as 1 or 0.
+int32_t grace_read_bool(void);
+
+// A word. Long words get memory of their own that stays valid for the rest
+// of the program.
+grace_string grace_read_str(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GRACE_RT_H